@@ -6,127 +6,110 @@
 //  Copyright 2020 Muhammed Okumus. All rights reserved.
 //
 
-#include <stdio.h>
-#include <stdlib.h>  
-#include <string.h> 
-#include <math.h>       
-#include <time.h>       
-#include <limits.h>
-#include <time.h>
-#include <errno.h>
-#include <pthread.h> 
-
-#define NAME 32
-#define N_THREADS 4
-#define DEBUG 0
-#define MAX_PATH 1024
-
-/*============================================
-=            Page Table Structure            =
-============================================*/
+#include "vm.h"
+#include "workload.h"
+#include "pool.h"
+#include <unistd.h>
 
-typedef struct{
-    unsigned int addr_virtual;          // VM address space
-    int addr_physical;                  // RAM address space
-    int modified;                       // Modified bit
-    int present;                        // Present bit
-    int referenced;                     // Referenced bit
-    int owner;                          // Owner process ID
-    int age;                            // Age bit
-    struct timespec reference_time;   
-    struct timespec load_time; 
-}Entry;
-
-typedef struct{
-    int page_size;
-    Entry* page_table;
-}VirtualMemory;
+#define MERGE_CHUNK 1024    // merge() output buffer in integers
+#define PAR_GRAIN 8192      // Parallel sorts go sequential below this many integers
+#define N_TESTS 9           // Geometries per PR/AP pair
+#define GEOMETRY_FS 6       // Geometry of the first test, log2 of the frame size,
+#define GEOMETRY_NP 10      // physical and virtual frames, see -G
+#define GEOMETRY_NV 14
+#define MAX_THREADS 16      // Workload threads, see -w and -g
 
-/*==========================================
-=            Statistics Structs            =
-==========================================*/
+typedef struct Data Data;
 
+/*
+    Workload registry entry. A selected workload runs on its own thread
+    and slice of the virtual memory, shift cuts the slice for the
+    quadratic sorts.
+*/
 typedef struct{
-    char name[NAME];
-    int owner;
-    unsigned long long n_reads;
-    unsigned long long n_writes;
-    int n_misses;
-    int n_replacements;
-    int n_dpw;
-    int n_dpr;
-} Stats;
-
+    const char* key;        // Name on the command line
+    const char* name;       // Context name
+    void (*run)(Data *d);   // Works on [d->start, d->end)
+    int shift;              // Range is at most n_words >> shift, 0 for the whole slice
+    int check;              // Range is sorted afterwards
+    int gen;                // Synthetic workload, access pattern from -g
+    int scratch;            // Second half of the slice is scratch space of the first
+    int parallel;           // Runs on a pool of sort_workers threads, see -t
+} Workload;
+
+// A thread of the workload, one per selected instance
+struct Data{
+    const Workload *w;
+    double wall;    // time taken in seconds
+    double cpu;     // CPU time of the thread(and its pool) in seconds
+    unsigned long long start;
+    unsigned long long end;
+    unsigned long long scratch; // Start of the scratch space, same length as the range
+    Context* c;     // Context the workload runs under
+    Generator gen;  // Access pattern of a generator thread
+    Context* workers[MAX_WORKERS];  // Pool contexts of a parallel sort, c and forks of it
+    int n_workers;
+    unsigned long long n_tasks, n_steals;
+};
+
+// Workload picked on the command line
 typedef struct{
-    double delta;   // time taken in seconds
-    unsigned long start;
-    unsigned long end;
-} Data;
-
-Stats stats_bs = {0};
-Stats stats_ms = {0};
-Stats stats_qs = {0};
-Stats stats_is = {0};
-Stats stats_ch = {0};
-Stats stats_other = {0};
-
-Data data_bs;
-Data data_ms;
-Data data_qs;
-Data data_is;
-
-
+    const Workload *w;
+    GenSpec spec;   // Generator threads only
+} Selection;
 
+/*
+    One test of the sweep, a PR/AP pair and a geometry. The report is
+    written to memory and printed by main in sweep order, so it does not
+    matter which worker ran the test or when.
+*/
+typedef struct{
+    int pr, ap, test;
+    int frame_size, num_virtual, num_physical;
+    int mrc;        // Record the miss ratio curve
+    int shards;     // Sample budget of the approximate curve, 0 if off
+    int shadow;     // Shadow every other PR/AP pair on this run
+    char* report;
+    size_t report_len;
+    int done;
+} Job;
 
 /*==============================
 =            Macros            =
 ==============================*/
 
 #define errExit(msg) do{ perror(msg); print_usage(); exit(EXIT_FAILURE); } while(0)
-#define _errExit(msg) do{ perror(msg); exit(EXIT_FAILURE); } while(0)
-#define debug(f_, ...) if(DEBUG == 1) printf((f_), ##__VA_ARGS__)
-
-/*========================================
-=            Global Constants            =
-========================================*/
-
-const char* PR_TYPES[] = {"NRU", "FIFO", "SC", "LRU"};
-const char* AP_TYPES[] = {"global","local"};
-const int PR_N =  sizeof(PR_TYPES) / sizeof(PR_TYPES[0]);
-const int AP_N =  sizeof(AP_TYPES) / sizeof(AP_TYPES[0]);
-clockid_t clk_id = CLOCK_MONOTONIC;
 
 /*===================================
 =            User Inputs            =
 ===================================*/
-int frame_size  = 6,        
-    num_physical = 10,
-    num_virtual = 14,
-    page_table_print_int = INT_MAX;
-
-char page_replacement[8],
-     alloc_policy[7],
-     *disk_file_name= "diskFile.dat";
-
+int frame_size  = GEOMETRY_FS,
+    num_physical = GEOMETRY_NP,
+    num_virtual = GEOMETRY_NV,
+    page_table_print_int = INT_MAX,
+    n_workers = 0,          // Tests run at the same time, 0 for one per online core, see -j
+    mrc_mode = 0,           // Analysis sweep, see -m
+    shards_budget = 0,      // SHARDS sample budget in pages, see -s
+    shadow_mode = 0,        // Every policy in one run, see -a
+    sort_workers = 4;       // Threads of each parallel sort, see -t
+
+char *disk_file_name= "diskFile.dat";
+char *trace_file_name = NULL;   // Access traces are recorded if set, see -r
+char *replay_file_name = NULL;  // Trace replayed instead of the sorts, see -p
+int replay_fast = 0;            // Replay ignores the traced interleaving, see -f
+int replay_test = 0;            // Test of the sweep with the geometry of the trace
+Selection selected[MAX_THREADS];    // Workload threads, see -w and -g
+int n_selected = 0;
 
 /*========================================
 =            Global Variables            =
 ========================================*/
 
-VirtualMemory VM;       // VM info & page table
-int* memory;            // Physical memory
-int* bitmap;            // Bitmap like int array to keep track of empty physical frames
-FILE * fd;              // VM file
-unsigned int n_words;   // # of integers in memory
-int n_vframes;          // # of virtual frames
-int n_pframes;          // # of physical frames
-int n_entries;          // # of total frames
-int f_size;             // frame size f_size = (2^N)
-int m_size;             // physical memory size
-
-unsigned long long total_mem_access = 0;
-pthread_mutex_t mutex_access  = PTHREAD_MUTEX_INITIALIZER;
-int exit_requested = 0;
+Job* jobs;              // Every test of the sweep in report order
+int n_jobs = 0;
+int next_job = 0;       // Next job a worker picks up
+pthread_mutex_t mutex_jobs = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t cond_job_done = PTHREAD_COND_INITIALIZER;
 
 /*===========================================
 =            Function Prototypes            =
@@ -134,923 +117,692 @@ int exit_requested = 0;
 
 // Misc Functions
 void print_usage();
-int compare_time(struct timespec t1, struct timespec t2);
-Stats* whos_stats(char *tName);
-void print_stats(Stats s);
-
-// Debug Functions
-void print_entry(Entry e);
-
-// Error Checking Functions
-int pr_validity(char* type);
-int ap_validity(char* type);
 
 // Integer Array Utility Functions
 void print_array(int* arr, int n);
 
-// VM Functions
-void initilize_vm();
-void print_pt();
-int to_addr_space(unsigned int i);
-int find_free_addr();
-
-// Get/Set Functions
-void set(unsigned int index, int value, char * tName);
-int get(unsigned int index, char * tName);
-
-// Page Replacement Functions
-int algorithm(int owner);
-int NRU(int owner);
-int FIFO(int owner);
-int SC(int owner);
-int LRU(int owner);
-int WSClock(int owner);
-
-// Clock Interrupt Routines
-void reset_r_bit();
+// Experiment Runner
+void run_test(Job *job, int id);
+void run_workloads(VirtualMemory *vm, FILE *out);
+void run_replay(VirtualMemory *vm, FILE *out);
+void *thread_worker(void *arg);
 
 // Sorting
-void print_disk(int s, int e);
-int is_sorted(int s, int e);
-void bubble_sort(int s, int e, char* c);
-void merge(int start, int mid, int end, char* c);
-void merge_sort(int left, int right, char* c);
-void quick_sort(int low, int high, char* c);
-int partition(int low, int high, char* c);
-void swap(int i, int j, char* c);
-void index_sort(int s, int e, char* c);
-
-// Threads
-void *thread_bubble_sort(void *arg);
-void *thread_merge_sort(void *arg);
-void *thread_quick_sort(void *arg);
-void *thread_index_sort(void *arg);
-void *thread_clock_interrupt(void *arg);
-
-int main(int argc, char* argv[]){
-    pthread_t thread_ids[N_THREADS];
-
-    srand(1000); // Rand seed requested in the pdf
-
-    /*=======================================================
-    =            Initilize Calculated Properties            =
-    =======================================================*/
-    n_words = pow(2,num_virtual) * pow(2,frame_size);
-    n_pframes = pow(2, num_physical);
-    n_vframes = pow(2, num_virtual);
-    n_entries = n_vframes + n_pframes;
-    f_size = pow(2, frame_size);
-    m_size = n_pframes * f_size;
-
-
-    int initial_frame_size = frame_size;
-    int initial_num_virtual = num_virtual;
-    int initial_num_physical = num_physical;
+void print_disk(long long s, long long e, Context* c);
+int is_sorted(long long s, long long e, Context* c);
+void bubble_sort(long long s, long long e, Context* c);
+void merge(long long start, long long mid, long long end, Context* c);
+void merge_sort(long long left, long long right, Context* c);
+void quick_sort(long long low, long long high, Context* c);
+long long partition(long long low, long long high, Context* c);
+void swap(long long i, long long j, Context* c);
+void index_sort(long long s, long long e, Context* c);
+void pmerge_run(Task *t, Worker *w);
+void pmerge_join(Task *t, Worker *w);
+void pquick_run(Task *t, Worker *w);
+void par_sort(Data *d, void (*run)(Task*, Worker*));
+void ext_sort(long long s, long long e, long long scratch, Context* c);
+long long ext_merge(long long src, long long dst, long long n, long long run, int k, Context* c);
+int cmp_int(const void *a, const void *b);
+
+// Workloads
+void run_bubble_sort(Data *d);
+void run_merge_sort(Data *d);
+void run_quick_sort(Data *d);
+void run_index_sort(Data *d);
+void run_ext_sort(Data *d);
+void run_pmerge_sort(Data *d);
+void run_pquick_sort(Data *d);
+void run_generator(Data *d);
+const Workload* workload_find(const char* key);
+void *thread_workload(void *arg);
 
+/*========================================
+=            Workload Registry           =
+========================================*/
 
-    unsigned int initial_words = n_words;
-    int initial_pframes = n_pframes;
-    int initial_vframes = n_vframes;
-    int initial_entries = n_entries;
-    int initial_f_size = f_size;
-    int initial_m_size = m_size;
+const Workload WORKLOADS[] = {
+    // key       name             run              shift check gen scratch parallel
+    {"bubble",  "Bubble Sort",    run_bubble_sort, 8,    1,    0,  0,      0},    // Reduced range for faster testing
+    {"merge",   "Merge Sort",     run_merge_sort,  0,    1,    0,  0,      0},
+    {"quick",   "Quick Sort",     run_quick_sort,  0,    1,    0,  0,      0},
+    {"index",   "Index Sort",     run_index_sort,  10,   1,    0,  0,      0},    // Quadratic like bubble sort
+    {"ext",     "External Sort",  run_ext_sort,    0,    1,    0,  1,      0},
+    {"pmerge",  "Par Merge Sort", run_pmerge_sort, 0,    1,    0,  0,      1},
+    {"pquick",  "Par Quick Sort", run_pquick_sort, 0,    1,    0,  0,      1},
+    {"gen",     "Gen",            run_generator,   0,    0,    1,  0,      0},
+};
+#define N_WORKLOADS (int) (sizeof(WORKLOADS) / sizeof(Workload))
 
+int main(int argc, char* argv[]){
+    pthread_t* workers;
+    int opt;
+
+    while((opt = getopt(argc, argv, "G:j:ms:ar:p:fw:g:t:")) != -1){
+        switch(opt){
+            case 'p': replay_file_name = optarg; break;
+            case 'f': replay_fast = 1; break;
+            case 'w': {
+                // name[:threads]
+                char key[NAME], *colon;
+                int n = 1;
+
+                snprintf(key, NAME, "%s", optarg);
+                if((colon = strchr(key, ':')) != NULL){
+                    *colon = '\0';
+                    n = atoi(colon + 1);
+                }
+                const Workload *w = workload_find(key);
+                if(w == NULL || w->gen || n < 1 || n_selected + n > MAX_THREADS)
+                    errExit("Invalid workload");
+                while(n-- > 0)
+                    selected[n_selected++].w = w;
+                break;
+            }
+            case 'g':
+                if(n_selected == MAX_THREADS || gen_parse(optarg, &selected[n_selected].spec) == -1)
+                    errExit("Invalid workload");
+                selected[n_selected++].w = workload_find("gen");
+                break;
+            case 'r': trace_file_name = optarg; break;
+            case 'a': shadow_mode = 1; break;
+            case 'G':
+                // frameSize,numPhysical,numVirtual
+                if(sscanf(optarg, "%d,%d,%d", &frame_size, &num_physical, &num_virtual) != 3)
+                    errExit("Invalid geometry");
+                break;
+            case 'j':
+                if((n_workers = atoi(optarg)) < 1)
+                    errExit("Invalid # of jobs");
+                break;
+            case 'm': mrc_mode = 1; break;
+            case 's': shards_budget = atoi(optarg); break;
+            case 't': sort_workers = atoi(optarg); break;
+            default: errExit("Invalid arguments");
+        }
+    }
+    if(optind != argc)
+        errExit("Invalid arguments");
+    // Every test of the sweep needs a frame of at least 2 integers and 2 frames,
+    // frame numbers fit PTE_FRAME and the frame size an int
+    if(frame_size < 1 || frame_size + N_TESTS - 1 > 30 || num_physical - (N_TESTS - 1) < 1 ||
+       num_physical > 30 || num_physical > num_virtual || frame_size + num_virtual > 62)
+        errExit("Invalid geometry");
+    if(shards_budget < 0)
+        errExit("Invalid sample budget");
+    if(sort_workers < 1 || sort_workers > MAX_WORKERS)
+        errExit("Invalid # of sort workers");
+    if(replay_file_name != NULL && trace_file_name != NULL)
+        errExit("Invalid arguments, -p and -r");
+    if(replay_file_name != NULL && n_selected > 0)
+        errExit("Invalid arguments, -p and -w/-g");
+    if(n_selected == 0){
+        // The four sorts of the assignment
+        selected[n_selected++].w = workload_find("bubble");
+        selected[n_selected++].w = workload_find("merge");
+        selected[n_selected++].w = workload_find("quick");
+        selected[n_selected++].w = workload_find("index");
+    }
+    if(replay_file_name != NULL){
+        // Only the test of the sweep with the traced geometry is run
+        TraceReader *r = trace_open(replay_file_name);
+        if(r == NULL) errExit("Error: Can not read trace");
+        for(int i = 1; i <= N_TESTS; i++){
+            int fs = frame_size + i - 1, nv = num_virtual - (i - 1);
+            if(r->header->f_size == (1ULL << fs) && r->header->n_words == (1ULL << (fs + nv)))
+                replay_test = i;
+        }
+        trace_reader_close(r);
+        if(replay_test == 0)
+            errExit("Error: Trace geometry is not one of the sweep");
+    }
 
     /*===================================================
-    =            Virtual Memory Initlization            =
+    =            Build The Sweep                        =
     ===================================================*/
-    // Open VM file
-    fd = fopen(disk_file_name, "w+");
-    if (fd == NULL) errExit("Error opening file @initilize_vm");
-
-    // Fill VM file with random integers
-    initilize_vm(frame_size, num_virtual);
-
-    // Allacote page table
-    VM.page_table = calloc(n_entries, sizeof(Entry));
-    // Initlize page table
-    for(int i = 0; i < n_entries; i++){
-        VM.page_table[i].addr_virtual = i * f_size;
-        VM.page_table[i].addr_physical = -1;
-    }
-
-    // Allocate physical memory for simulation
-    memory = calloc(m_size, sizeof(int));
-    // Allocate swap space(backing store)
-    bitmap = calloc(n_pframes, sizeof(int));
-
-    /*=====  End of Virtual Memory Initlization  ======*/
-
-    data_bs.start = 0;
-    data_bs.end =  n_words / pow(2,8);
-
-    data_ms.start = n_words / 4;
-    data_ms.end = n_words / 4 * 2;
-
-    data_qs.start = n_words / 4 * 2;
-    data_qs.end = n_words / 4 * 3;
-
-    data_is.start = n_words / 4 * 3;
-    data_is.end = n_words;
-
+    jobs = calloc(PR_N * AP_N * N_TESTS, sizeof(Job));
+    if(jobs == NULL) _errExit("calloc @main");
 
     for(int pr = 0; pr < PR_N; pr++){
-        memset(page_replacement, '\0', sizeof(page_replacement));
-        strcpy(page_replacement, PR_TYPES[pr]);
-
         for(int ap = 0; ap < AP_N; ap++){
-            memset(alloc_policy, '\0', sizeof(alloc_policy));
-            strcpy(alloc_policy, AP_TYPES[ap]);
-
-
-
-            // Reset to initial values for next test group
-
-
-            frame_size = initial_frame_size;
-            num_virtual = initial_num_virtual;
-            num_physical = initial_num_physical;
-
-            n_words = initial_words;
-            n_pframes = initial_pframes;
-            n_vframes = initial_vframes;
-            n_entries = initial_entries;
-            f_size = initial_f_size;
-            m_size = initial_m_size;
-
-
-            printf("\n!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
-            printf("Testing with %s PR and %s AP\n", page_replacement,alloc_policy);
-
-            for(int i = 1; i <= 9; i++){
-
-                    exit_requested = 0;
-
-                    printf("\n**********************TEST %d***************************\n",i);
-
-
-                    printf("==============================\n");
-                    printf("Frame size: %.2fKB\n", f_size/pow(2,10));
-                    printf("# entries: %d\n", n_entries);
-                    printf("# words: %d\n", n_words);
-                    printf("RAM: %.0f KB\n", m_size/pow(2,10));
-                    printf("VM : %.0f KB\n", n_words/pow(2,10));
-                    printf("==============================\n");
-
-                    printf("Bubble Sort[%lu, %lu] // Reduced range for faster testing\n",data_bs.start, data_bs.end);
-                    printf("Merge Sort[%lu, %lu]\n",data_ms.start, data_ms.end);
-                    printf("Quick Sort[%lu, %lu]\n",data_qs.start, data_qs.end);
-                    printf("Index Sort[%lu, %lu]\n",data_is.start, data_is.end);
-                    printf("===============================\n");
-
-
-                    pthread_create(&thread_ids[0], NULL, thread_bubble_sort, NULL); 
-                    pthread_create(&thread_ids[1], NULL, thread_quick_sort, NULL); 
-                    pthread_create(&thread_ids[2], NULL, thread_merge_sort, NULL); 
-                    pthread_create(&thread_ids[3], NULL, thread_index_sort, NULL); 
-
-
-                    pthread_t t_int;
-                    pthread_create(&t_int, NULL, thread_clock_interrupt, NULL); 
-
-                    for(int x = 0; x < N_THREADS; x++)
-                        pthread_join(thread_ids[x], NULL);
-
-                    exit_requested = 1;
-
-                    pthread_join(t_int, NULL);
-
-                    print_stats(stats_bs);
-                    printf("Sort success: %s \n", (0 == is_sorted(data_bs.start,data_bs.end)) ? "yes" : "no");
-                    printf("Took %f seconds to execute \n", data_bs.delta);
-                    printf("===============================\n");
-                    print_stats(stats_qs);
-                    printf("Sort success: %s \n", (0 == is_sorted(data_qs.start,data_qs.end)) ? "yes" : "no");
-                    printf("Took %f seconds to execute \n", data_qs.delta);
-                    printf("===============================\n");
-                    print_stats(stats_ms);
-                    printf("Sort success: %s \n", (0 == is_sorted(data_ms.start,data_ms.end)) ? "yes" : "no");
-                    printf("Took %f seconds to execute \n", data_ms.delta);
-                    printf("===============================\n");
-                    print_stats(stats_is);
-                    printf("Sort success: %s \n", (0 == is_sorted(data_is.start,data_is.end)) ? "yes" : "no");
-                    printf("Took %f seconds to execute \n", data_is.delta);
-                    printf("===============================\n");
-                    print_stats(stats_ch); 
-
-
-                    /*=======================================================
-                    =            Update Calculated Properties              =
-                    =======================================================*/
-                    frame_size++;
-                    num_virtual--;
-                    num_physical--;
-                    n_words = pow(2,num_virtual) * pow(2,frame_size);
-                    n_pframes = pow(2, num_physical);
-                    n_vframes = pow(2, num_virtual);
-                    n_entries = n_vframes + n_pframes;
-                    f_size = pow(2, frame_size);
-                    m_size = n_pframes * f_size;
-
-                    data_bs.start = 0;
-                    data_bs.end =  n_words / pow(2,8);
-
-                    data_ms.start = n_words / 4;
-                    data_ms.end = n_words / 4 * 2;
-
-                    data_qs.start = n_words / 4 * 2;
-                    data_qs.end = n_words / 4 * 3;
-
-                    data_is.start = n_words / 4 * 3;
-                    data_is.end = n_words;
-
-                    // Re-init VM
-                    initilize_vm(frame_size, num_virtual);
-
-
-                    // Initlize page table
-                    for(int j = 0; j < n_entries; j++){
-                        VM.page_table[j].addr_virtual = j * f_size;
-                        VM.page_table[j].addr_physical = -1;
-                        VM.page_table[j].referenced = 0;
-                        VM.page_table[j].present = 0;
-                        VM.page_table[j].modified = 0;
-                        VM.page_table[j].owner = 0;
-                        VM.page_table[j].age = 0;
-                        VM.page_table[j].reference_time.tv_sec = 0;
-                        VM.page_table[j].reference_time.tv_nsec = 0;
-                        VM.page_table[j].load_time.tv_sec = 0;
-                        VM.page_table[j].load_time.tv_nsec = 0;
-                    }
-                    memset( &stats_bs, 0, sizeof(Stats) );
-                    memset( &stats_ms, 0, sizeof(Stats) );
-                    memset( &stats_qs, 0, sizeof(Stats) );
-                    memset( &stats_is, 0, sizeof(Stats) );
-                    memset( &stats_ch, 0, sizeof(Stats) );
-                    memset( &stats_other, 0, sizeof(Stats) );
-                    
-                    for(int k = 0; k < n_pframes; k++)
-                        bitmap[k] = 0;
+            // Every group starts from the initial geometry
+            int fs = frame_size, nv = num_virtual, np = num_physical;
+
+            // The curve covers every memory size at once and shadows every
+            // policy, only the page size needs its own run. LRU global so
+            // the simulated misses can be checked against the curve.
+            if((mrc_mode || shadow_mode) && (pr != pr_validity("LRU") || ap != ap_validity("global")))
+                continue;
+
+            for(int i = 1; i <= N_TESTS; i++){
+                if(replay_test != 0 && i != replay_test){
+                    fs++; nv--; np--;
+                    continue;
                 }
-            printf("\n!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
+                Job *job = &jobs[n_jobs++];
+                job->pr = pr;
+                job->ap = ap;
+                job->test = i;
+                job->frame_size = fs++;
+                job->num_virtual = nv--;
+                job->num_physical = np--;
+                job->mrc = mrc_mode;
+                job->shards = shards_budget;
+                job->shadow = shadow_mode;
+            }
         }
-        
-
     }
 
-    
-    
+    /*===================================================
+    =            Run And Report In Order                =
+    ===================================================*/
+    if(n_workers == 0)
+        n_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if(n_workers > n_jobs)
+        n_workers = n_jobs;
+    if(n_workers < 1)
+        n_workers = 1;
+    workers = malloc(sizeof(pthread_t) * n_workers);
+    if(workers == NULL) _errExit("malloc @main");
+    for(int w = 0; w < n_workers; w++)
+        pthread_create(&workers[w], NULL, thread_worker, NULL);
+
+    for(int k = 0; k < n_jobs; k++){
+        Job *job = &jobs[k];
+
+        if(k == 0 || jobs[k - 1].pr != job->pr || jobs[k - 1].ap != job->ap){
+            printf("\n!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
+            printf("Testing with %s PR and %s AP\n", PR_TYPES[job->pr], AP_TYPES[job->ap]);
+        }
 
+        pthread_mutex_lock(&mutex_jobs);
+        while(!job->done)
+            pthread_cond_wait(&cond_job_done, &mutex_jobs);
+        pthread_mutex_unlock(&mutex_jobs);
 
+        fwrite(job->report, 1, job->report_len, stdout);
+        fflush(stdout);
+        free(job->report);
 
-    //print_disk(data_ms.start,data_ms.end);
+        if(k == n_jobs - 1 || jobs[k + 1].pr != job->pr || jobs[k + 1].ap != job->ap)
+            printf("\n!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
+    }
+
+    for(int w = 0; w < n_workers; w++)
+        pthread_join(workers[w], NULL);
 
     /*======================================
     =            Free Resources            =
     ======================================*/
-    free(memory);
-    free(bitmap);
-    free(VM.page_table);
-    fclose(fd);
+    free(workers);
+    free(jobs);
 }
 
-/**
- *  Initlizes disk file that represent virtual memory.
- *  File is pointed by global variable fd, it must be open 
- *  before calling this function.
- */
-void initilize_vm(){
-    debug("Initilizing virtual memory with random integers...\n");
-    clock_t t = clock();
-    // Write to file
-    fseek(fd, 0, SEEK_SET);
-    for(int i = 0; i < n_words; i++){
-        int r = (int) rand();
-        fwrite(&r, sizeof(int), 1, fd); if(errno < 0) _errExit("fwrite @initilize_vm: 1");
-    }
-
-    t = clock() - t;
-    double time_taken = ((double)t)/CLOCKS_PER_SEC; // calculate the elapsed time
-    debug("Virtual memory initilized in %f seconds.\n", time_taken);
-}
+/*=============================================
+=            Experiment Runner                =
+=============================================*/
 
-/**
- *  Returns a copy of the integer at index. If the integer is not
- *  in phscial memory, pulls page to the memory.
- *  If the memory is full, a page replacement algorithm is called.
- *  Write back is handled if necessary.
- */
-
-Stats* whos_stats(char *tName){
-    Stats *s;
-    char c = tName[0];
-    switch(c){
-        case 'b': 
-            s = &stats_bs; 
-            snprintf(s->name, NAME,"%s", "Bubble Sort");
-            s->owner = (ap_validity(alloc_policy) == 1) ? 1 : 0;
-            break;
-        case 'q':
-            s = &stats_qs; 
-            snprintf(s->name, NAME,"%s", "Quick Sort");
-            s->owner = (ap_validity(alloc_policy) == 1) ? 2 : 0;
-            break;
-        case 'm': 
-            s = &stats_ms;
-            snprintf(s->name, NAME,"%s", "Merge Sort");
-            s->owner = (ap_validity(alloc_policy) == 1) ? 3 : 0;
-            break;
-        case 'i': 
-            s = &stats_is; 
-            snprintf(s->name, NAME,"%s", "Index Sort");
-            s->owner = (ap_validity(alloc_policy) == 1) ? 4 : 0;
-            break;
-        case 'c': 
-            s = &stats_ch; 
-            snprintf(s->name, NAME,"%s", "Check");
-            s->owner = 0;
-            break;
-        default: 
-            s = &stats_other; 
-            snprintf(s->name, NAME,"%s", "Other");
-            s->owner = 0;
+/*
+    Worker of the experiment runner, takes jobs in sweep order until
+    none are left. Tests are independent machines so any number of
+    them can run at once.
+*/
+void *thread_worker(void *arg){
+    int k;
+
+    while(1){
+        pthread_mutex_lock(&mutex_jobs);
+        k = next_job++;
+        pthread_mutex_unlock(&mutex_jobs);
+        if(k >= n_jobs)
             break;
-    }
 
-    return s;
-}
-
-void print_stats(Stats s){
-    printf("#%d - %s stats\n"
-            "# Reads: %llu\n"
-            "# Writes: %llu\n"
-            "# Misses: %d\n"
-            "# Replacements: %d\n"
-            "# DPW: %d\n"
-            "# DPR: %d\n",
-            s.owner, s.name, s.n_reads, s.n_writes, s.n_misses, s.n_replacements, s.n_dpw, s.n_dpr);
-}
-
-int get(unsigned int index, char * tName){
-    pthread_mutex_lock(&mutex_access);
-    int k, j, result = -1;
-    Entry *e;
-    Stats *s;
-
-    if(index >= n_words) _errExit("Error: Index out of range @get");
-
-    s = whos_stats(tName);
-    s->n_reads++;
-    
+        run_test(&jobs[k], k);
 
-    // Get table entry that covering given index
-    k = to_addr_space(index);
-    e = &VM.page_table[k];
-    e->owner = s->owner;
-    // If integer in physcial memory
-    if(e->present){
-        debug("Index %d in memory\n", index);
-        int c  = e->addr_physical + index%f_size;
-        e->present = 1;
-        e->referenced = 1;
-        clock_gettime(clk_id, &e->reference_time);
-        result = memory[c];
+        pthread_mutex_lock(&mutex_jobs);
+        jobs[k].done = 1;
+        pthread_cond_broadcast(&cond_job_done);
+        pthread_mutex_unlock(&mutex_jobs);
     }
-    // If integer in virtual memory 
-    else{
-        s->n_misses++;
-        s->n_dpr++;
-        debug("Index %d not in memory\n", index);
-        // Is there a free spot on memory
-        j = find_free_addr();
-        if(j != -1){
-            debug("Free spot found at frame #%d\n", j);
-            bitmap[j] = 1;   // Occupied now
-
-
-            // New page, no old pages modified here since memory had empty space
-            e->referenced = 1;
-            e->present = 1;
-            clock_gettime(clk_id, &e->reference_time);
-            clock_gettime(clk_id, &e->load_time);
-            e->addr_physical = j * f_size;      // physical address
-
-            fseek(fd, sizeof(int) * e->addr_virtual, SEEK_SET);        if(errno < 0)  _errExit("Error: fseek @get");
-            fread(&memory[e->addr_physical], sizeof(int),f_size, fd);  if(errno < 0)  _errExit("Error: fread @get");
-
-            int c  = e->addr_physical + index%f_size;
-            result = memory[c];  
-        }
-        else{
-            s->n_replacements++;
-            debug("No free spots, running PR algorithm\n");
-            // Find page to swap
-            j = algorithm(s->owner); 
-
-            if(j == -1){
-                debug("Local allocation failed, trying global allocation\n");
-                j = algorithm(0);
-                if(j == -1)
-                    _errExit("Page replacement error");
-            }
+    pthread_exit(0);
+}
 
-            debug("replacing page #%d, with address:%d \n", j, VM.page_table[j].addr_physical);
-
-            // Write back if necessary
-            if(VM.page_table[j].modified){
-                debug("Page %d is modified, write back required\n", j);
-                // Write back required, ram to disk
-                fseek(fd, sizeof(int) * VM.page_table[j].addr_virtual, SEEK_SET);       if(errno < 0) _errExit("Error: fseek @get");
-                fwrite(&memory[VM.page_table[j].addr_physical], sizeof(int), f_size, fd); if(errno < 0) _errExit("Error: fwrite @get");
-            }  
-
-            // New page
-            e->referenced = 1;
-            e->present = 1;
-            clock_gettime(clk_id, &e->reference_time);
-            clock_gettime(clk_id, &e->load_time);
-            e->addr_physical = VM.page_table[j].addr_physical; 
-
-            // Old page
-            VM.page_table[j].age = 0;
-            VM.page_table[j].referenced = 0;
-            VM.page_table[j].present = 0;
-            VM.page_table[j].addr_physical = -1; // Clear physcial address
-
-            // Disk to ram
-            fseek(fd, sizeof(int) * e->addr_virtual, SEEK_SET);        if(errno < 0)  _errExit("Error: fseek @get");
-            fread(&memory[e->addr_physical], sizeof(int),f_size, fd);  if(errno < 0)  _errExit("Error: fread @get");
-
-            int c  = e->addr_physical + index%f_size;
-            result = memory[c];
+/**
+ *  Runs one test on its own machine and disk file and writes the report
+ *  to job->report. The disk is filled from the same seed for every test
+ *  so a test reads the same integers whichever worker runs it.
+ */
+void run_test(Job *job, int id){
+    char path[MAX_PATH], trace_path[MAX_PATH];
+    unsigned long long trace_events = 0, trace_bytes = 0;
+    VirtualMemory *vm;
+    FILE *out;
+
+    out = open_memstream(&job->report, &job->report_len);
+    if(out == NULL) _errExit("open_memstream @run_test");
+
+    // Disk file per test, diskFile.dat -> diskFile.dat.<id>
+    snprintf(path, MAX_PATH, "%s.%d", disk_file_name, id);
+    vm = vm_create(path, job->frame_size, job->num_virtual, job->num_physical,
+                   job->pr, job->ap, 1000);    // Rand seed requested in the pdf
+    if(job->mrc)
+        vm->mrc = mrc_create(vm->n_vframes);
+    if(job->shards)
+        vm->shards = shards_create(vm->n_vframes, job->shards);
+    for(int pr = 0; job->shadow && pr < PR_N; pr++){
+        for(int ap = 0; ap < AP_N; ap++){
+            if(pr != job->pr || ap != job->ap)
+                vm_add_shadow(vm, pr, ap);
         }
     }
-    pthread_mutex_unlock(&mutex_access);
-    return result;
-}
 
-void set(unsigned int index, int value, char * tName){
-    pthread_mutex_lock(&mutex_access);
-    int k, j;
-    Entry *e;
-    Stats *s;
+    fprintf(out, "\n**********************TEST %d***************************\n", job->test);
 
-    if(index >= n_words) _errExit("Error: Index out of range @set");
 
-    s = whos_stats(tName);
-    s->n_writes++;
+    fprintf(out, "==============================\n");
+    fprintf(out, "Frame size: %.2fKB\n", vm->f_size/pow(2,10));
+    fprintf(out, "# entries: %lld\n", vm->n_entries);
+    fprintf(out, "# words: %llu\n", vm->n_words);
+    fprintf(out, "RAM: %.0f KB\n", vm->m_size/pow(2,10));
+    fprintf(out, "VM : %.0f KB\n", vm->n_words/pow(2,10));
+    fprintf(out, "==============================\n");
 
-    
+    // Trace per test like the disk file, trace.dat -> trace.dat.<id>
+    if(trace_file_name != NULL){
+        snprintf(trace_path, MAX_PATH, "%s.%d", trace_file_name, id);
+        vm_trace_start(vm, trace_path);
+    }
 
+    if(replay_file_name != NULL)
+        run_replay(vm, out);
+    else
+        run_workloads(vm, out);
 
-    // Get table entry that covering given index
-    k = to_addr_space(index);
-    e = &VM.page_table[k];
-
-    e->owner = s->owner;
-    // If integer in physcial memory
-    if(e->present){
-        debug("Index %d in memory\n", index);
-        int c  = e->addr_physical + index%f_size;
-        e->present = 1;
-        e->referenced = 1;
-        e->modified = 1;
-        clock_gettime(clk_id, &e->reference_time);
-        memory[c] = value;
+    if(vm->trace != NULL){
+        trace_events = vm->trace->n_events;
+        trace_bytes = vm_trace_stop(vm);
+        fprintf(out, "Trace: %llu events, %.2f KB(%.2f bytes/event) in %s\n", trace_events,
+                trace_bytes/pow(2,10), (double) trace_bytes / (trace_events ? trace_events : 1), trace_path);
     }
-    // If integer in virtual memory 
-    else{
-        s->n_misses++;
-        s->n_dpw++;
-        debug("Index %d not in memory\n", index);
-        // Is there a free spot on memory
-        j = find_free_addr();
-        if(j != -1){
-            debug("Free spot found at frame #%d\n", j);
-            bitmap[j] = 1;   // Occupied now
-
-
-            // New page, no old pages modified here since memory had empty space
-            e->referenced = 1;
-            e->present = 1;
-            e->modified = 1;
-            clock_gettime(clk_id, &e->reference_time);
-            clock_gettime(clk_id, &e->load_time);
-            e->addr_physical = j * f_size;      // physical address
-
-            fseek(fd, sizeof(int) * e->addr_virtual, SEEK_SET);        if(errno < 0)  _errExit("Error: fseek @set");
-            fread(&memory[e->addr_physical], sizeof(int),f_size, fd);  if(errno < 0)  _errExit("Error: fread @set");
-
-            int c  = e->addr_physical + index%f_size;
-            memory[c] = value;  
-        }
-        else{
-            s->n_replacements++;
-            debug("No free spots, running PR algorithm\n");
-            // Find page to swap
-            j = algorithm(s->owner); 
-
-            if(j == -1){
-                debug("Local allocation failed, trying global allocation\n");
-                j = algorithm(0);
-                if(j == -1)
-                    _errExit("Page replacement error");
-            }
 
-            debug("replacing page #%d, with address:%d \n", j, VM.page_table[j].addr_physical);
-            
-            // Write back if necessary
-            if(VM.page_table[j].modified){
-                debug("Page %d is modified, write back required\n", j);
-                // Write back required, ram to disk
-                fseek(fd, sizeof(int) * VM.page_table[j].addr_virtual, SEEK_SET);       if(errno < 0) _errExit("Error: fseek @set");
-                fwrite(&memory[VM.page_table[j].addr_physical], sizeof(int), f_size, fd); if(errno < 0) _errExit("Error: fwrite @set");
-            }  
-
-            // New page
-            e->referenced = 1;
-            e->present = 1;
-            e->modified = 1;
-            clock_gettime(clk_id, &e->reference_time);
-            clock_gettime(clk_id, &e->load_time);
-            e->addr_physical = VM.page_table[j].addr_physical; 
-
-            // Old page
-            VM.page_table[j].age = 0;
-            VM.page_table[j].referenced = 0;
-            VM.page_table[j].present = 0;
-            VM.page_table[j].addr_physical = -1; // Clear physcial address
-
-            // Disk to ram
-            fseek(fd, sizeof(int) * e->addr_virtual, SEEK_SET);        if(errno < 0)  _errExit("Error: fseek @set");
-            fread(&memory[e->addr_physical], sizeof(int),f_size, fd);  if(errno < 0)  _errExit("Error: fread @set");
-
-            int c  = e->addr_physical + index%f_size;
-            memory[c] = value;
-        }
+    Stats total = stats_total(vm);
+    fprintf(out, "===============================\n");
+    print_stats(out, &total);
+    fprintf(out, "Pinned frames: %d, peak: %d\n", vm->n_pinned, vm->max_pinned);
+    print_vm_stats(vm, out);
+
+    if(vm->mrc != NULL){
+        char csv[MAX_PATH];
+
+        fprintf(out, "===============================\n");
+        mrc_print(vm->mrc, out, vm->n_pframes, vm->f_size);
+        snprintf(csv, MAX_PATH, "mrc_%d.csv", vm->f_size);
+        if(mrc_write(vm->mrc, csv, vm->f_size) == -1)
+            _errExit("mrc_write @run_test");
+        fprintf(out, "Full curve written to %s\n", csv);
+    }
+    if(vm->shards != NULL){
+        fprintf(out, "===============================\n");
+        shards_print(vm->shards, out, vm->n_pframes, vm->f_size, vm->mrc);
+    }
+    if(vm->n_shadows > 0){
+        fprintf(out, "===============================\n");
+        print_shadow_stats(vm, out);
     }
 
-    pthread_mutex_unlock(&mutex_access);
+    vm_destroy(vm);
+    remove(path);
+    fclose(out);
 }
 
 /*
-    Used to determine page table entry index using the virtual address(i)
-    Example for frame size 4096
-    i: 1        -> 0
-    i: 4096     -> 1
-    i: 6144     -> 1
-    i: 8192     -> 2
-    i: 10240    -> 2
+    The selected workloads, a thread each on its own equal slice of the
+    virtual memory like the four sorts on quarters. Sorted ranges are
+    checked afterwards.
 */
-int to_addr_space(unsigned int i){
-    return (i/f_size);   // By the power of int division(truncation towards zero)
-}
-
-/*
-    Return a page table entry index that points to a present frame,
-    if owner > 0, perform local allocation, only look for entries.owner == owner
-    if owner <=, perform global allocation
-*/
-int NRU(int owner){
-    Entry *e;
-    // CLASS 0: !referenced && !modified
-    for(int i = 0; i < n_entries; i++) {
-        e = &VM.page_table[i];
-        if(e->present){
-            if(owner <= 0){
-                if(!e->referenced && !e->modified)
-                    return i;  
-            }
-            else{
-                if(!e->referenced && !e->modified && e->owner == owner)
-                    return i;  
-            }
+void run_workloads(VirtualMemory *vm, FILE *out){
+    pthread_t thread_ids[MAX_THREADS], t_int;
+    Data data[MAX_THREADS];
+    Context *ctx_ch = NULL;
+    char name[NAME], desc[64];
+    struct timespec t0, t1;
+    double wall;
+
+    for(int k = 0; k < n_selected; k++){
+        const Workload *w = selected[k].w;
+        Data *d = &data[k];
+        int n = 0, same = 0;
+
+        memset(d, 0, sizeof(Data));
+        d->w = w;
+        d->start = vm->n_words / n_selected * k;
+        d->end = (k == n_selected - 1) ? vm->n_words : vm->n_words / n_selected * (k + 1);
+        if(w->shift && d->end - d->start > (vm->n_words >> w->shift))
+            d->end = d->start + (vm->n_words >> w->shift);
+        if(w->gen && (selected[k].spec.set & GS_RANGE)){
+            d->start = (unsigned long long) (selected[k].spec.lo * vm->n_words);
+            d->end = (unsigned long long) (selected[k].spec.hi * vm->n_words);
         }
-    }
-    // CLASS 1: !referenced && modified
-    for(int i = 0; i < n_entries; i++) {
-        e = &VM.page_table[i];
-        if(e->present){
-            if(owner <= 0){
-                if(!e->referenced && e->modified)
-                    return i;  
-            }
-            else{
-                if(!e->referenced && e->modified && e->owner == owner)
-                    return i;  
-            }
+        if(w->scratch){
+            d->scratch = d->start + (d->end - d->start + 1) / 2;
+            d->end = d->start + (d->end - d->start) / 2;
         }
-    }
-    // CLASS 2: referenced && !modified
-    for(int i = 0; i < n_entries; i++) {
-        e = &VM.page_table[i];
-        if(e->present){
-            if(owner <= 0){
-                if(e->referenced && !e->modified)
-                    return i;  
+
+        // Instances of the same workload are numbered
+        for(int i = 0; i < n_selected; i++){
+            if(selected[i].w == w){
+                same++;
+                if(i <= k) n++;
             }
-            else{
-                if(e->referenced && !e->modified && e->owner == owner)
-                    return i;  
-            }  
         }
-    }
-    // CLASS 3: referenced && modified
-    for(int i = 0; i < n_entries; i++) {
-        e = &VM.page_table[i];
-        if(e->present){
-            if(owner <= 0){
-                if(e->referenced && e->modified)
-                    return i;  
+        if(same > 1) snprintf(name, NAME, "%s %d", w->name, n);
+        else         snprintf(name, NAME, "%s", w->name);
+        d->c = ctx_create(vm, name, 0);
+        if(w->parallel){
+            // Workers are threads of the same process, they share its owner
+            d->workers[0] = d->c;
+            for(d->n_workers = 1; d->n_workers < sort_workers; d->n_workers++){
+                char wname[2 * NAME];  // Cut to NAME by ctx_fork
+                snprintf(wname, sizeof(wname), "%s/%d", name, d->n_workers);
+                d->workers[d->n_workers] = ctx_fork(d->c, wname);
             }
-            else{
-                if(e->referenced && e->modified && e->owner == owner)
-                    return i;  
-            }  
         }
-    }
-
 
-    return -1;
-}
-
-int FIFO(int owner){
-    Entry *e;
-    int k = -1;
-    struct timespec tmax;
-    tmax.tv_sec = INT_MAX;
-    tmax.tv_nsec = LONG_MAX;
-
-    for(int i = 0; i < n_entries; i++) {
-        e = &VM.page_table[i];
-        if(e->present){
-            if(owner <= 0){ // Global alloc
-                if(compare_time(e->load_time, tmax) == -1){
-                    tmax.tv_sec = e->load_time.tv_sec;
-                    tmax.tv_nsec = e->load_time.tv_nsec;
-                    k = i;
-                }
-            }
-            else{   // Local alloc
-                if(e->owner == owner && compare_time(e->load_time, tmax) == -1){
-                    tmax.tv_sec = e->load_time.tv_sec;
-                    tmax.tv_nsec = e->load_time.tv_nsec;
-                    k = i;
-                }
-            }
+        fprintf(out, "%s[%llu, %llu]", name, d->start, d->end);
+        if(w->gen){
+            gen_init(&d->gen, &selected[k].spec, d->start, d->end - d->start, vm->m_size);
+            gen_describe(&d->gen.spec, desc, sizeof(desc));
+            fprintf(out, " %s, %llu accesses, %.0f%% writes", desc, d->gen.spec.n_ops,
+                    d->gen.spec.write_ratio * 100);
         }
+        if(w->shift)
+            fprintf(out, " // Reduced range for faster testing");
+        if(w->scratch)
+            fprintf(out, ", scratch[%llu, %llu]", d->scratch, d->scratch + (d->end - d->start));
+        if(w->parallel)
+            fprintf(out, " on %d workers", d->n_workers);
+        fprintf(out, "\n");
+        if(w->check && ctx_ch == NULL)
+            ctx_ch = ctx_create(vm, "Check", 1);
     }
-    return k;
-}
-int SC(int owner){
-    Entry *e;
-    int k = -1, j = -1, reserved = 0;
-    struct timespec tmax;
-    tmax.tv_sec = INT_MAX;
-    tmax.tv_nsec = LONG_MAX;
-
-    for(int i = 0; i < n_entries; i++) {
-        e = &VM.page_table[i];
-        if(e->present){
-            if(owner <= 0){ // Global alloc
-                if(compare_time(e->load_time, tmax) == -1){
-                    if(e->referenced){ // If referenced, clear R bit and update load time
-                        e->referenced = 0;
-                        clock_gettime(clk_id, &e->load_time);
-                        if (reserved == 0){ // This would the tail if the structe was a linked list
-                            reserved = 1;
-                            j = i;  // Will return this if all present pages are referenced(tail)
-                        }
-                    }
-                    else{   // Update oldest unreferenced page
-                        k = i;
-                    }
-                    // Always update current oldest page time referenced or not
-                    tmax.tv_sec = e->load_time.tv_sec;
-                    tmax.tv_nsec = e->load_time.tv_nsec;
-                    
-                }
-            }
-            else{   // Local alloc
-                if(e->owner == owner && compare_time(e->load_time, tmax) == -1){
-                    if(e->referenced){ // If referenced, clear R bit and update load time
-                        e->referenced = 0;
-                        clock_gettime(clk_id, &e->load_time);
-                        if (reserved == 0){ // This would the tail if the structe was a linked list
-                            reserved = 1;
-                            j = i;  // Will return this if all present pages are referenced(tail)
-                        }
-                    }
-                    else{   // Update oldest unreferenced page
-                        k = i;
-                    }
-                    // Always update current oldest page time referenced or not
-                    tmax.tv_sec = e->load_time.tv_sec;
-                    tmax.tv_nsec = e->load_time.tv_nsec;
-                    
-                }
-            }
+    fprintf(out, "===============================\n");
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(int k = 0; k < n_selected; k++)
+        pthread_create(&thread_ids[k], NULL, thread_workload, &data[k]);
+    pthread_create(&t_int, NULL, thread_clock_interrupt, vm);
+
+    for(int k = 0; k < n_selected; k++)
+        pthread_join(thread_ids[k], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    vm->exit_requested = 1;
+    pthread_join(t_int, NULL);
+    wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    for(int k = 0; k < n_selected; k++){
+        Data *d = &data[k];
+        Stats st = ctx_snapshot(d->c);
+
+        // Counters of the whole pool under the name of the sort
+        for(int i = 1; i < d->n_workers; i++){
+            Stats f = ctx_snapshot(d->workers[i]);
+            stats_add(&st, &f);
         }
+        print_stats(out, &st);
+        if(d->w->parallel)
+            fprintf(out, "Workers: %d, tasks: %llu, steals: %llu\n", d->n_workers, d->n_tasks, d->n_steals);
+        if(d->w->check)
+            fprintf(out, "Sort success: %s \n", (0 == is_sorted(d->start, d->end, ctx_ch)) ? "yes" : "no");
+        fprintf(out, "Took %f seconds to execute, %f seconds CPU\n", d->wall, d->cpu);
+        if(d->w->gen)
+            fprintf(out, "%.2f M accesses/s\n", d->gen.n_done / d->wall / 1e6);
+        fprintf(out, "===============================\n");
     }
-
-    if(k == -1){
-        if(j == -1){
-            return -1;
-        }
-        k = j;
+    if(ctx_ch != NULL){
+        Stats ch = ctx_snapshot(ctx_ch);
+        print_stats(out, &ch);
     }
-    
-    return k;
+    fprintf(out, "Workloads took %f seconds\n", wall);
 }
-int LRU(int owner){
-    Entry *e;
-    int k = -1;
-    struct timespec tmax;
-    tmax.tv_sec = INT_MAX;
-    tmax.tv_nsec = LONG_MAX;;
-
-
-    for(int i = 0; i < n_entries; i++) {
-        e = &VM.page_table[i];
-        if(e->present){
-            if(owner <= 0){ // Global alloc
-                if(compare_time(e->reference_time, tmax) == -1){
-                    tmax.tv_sec = e->reference_time.tv_sec;
-                    tmax.tv_nsec = e->reference_time.tv_nsec;
-                    k = i;
-                }
-            }
-            else{   // Local alloc
-                if(e->owner == owner && compare_time(e->reference_time, tmax) == -1){
-                    tmax.tv_sec = e->reference_time.tv_sec;
-                    tmax.tv_nsec = e->reference_time.tv_nsec;
-                    k = i;
-                }
-            }
-        }
+
+/*
+    Replays the trace given with -p instead of running the sorts, the
+    contexts are the traced ones
+*/
+void run_replay(VirtualMemory *vm, FILE *out){
+    pthread_t t_int;
+    struct timespec t0, t1;
+    unsigned long long n;
+    double delta;
+    TraceReader *r = trace_open(replay_file_name);
+
+    if(r == NULL) errExit("Error: Can not read trace @run_replay");
+    for(int i = 0; i < trace_n_threads(r); i++)
+        ctx_create(vm, r->threads[i].name, r->threads[i].shared);
+
+    fprintf(out, "Replaying %s, %llu events of %d threads%s\n", replay_file_name,
+            (unsigned long long) trace_n_events(r), trace_n_threads(r),
+            replay_fast ? ", as fast as possible" : ", interleaving preserved");
+    fprintf(out, "===============================\n");
+
+    pthread_create(&t_int, NULL, thread_clock_interrupt, vm);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    n = vm_replay(vm, r, !replay_fast);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    vm->exit_requested = 1;
+    pthread_join(t_int, NULL);
+
+    delta = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    for(int i = 0; i < vm->n_contexts; i++){
+        Stats st = ctx_snapshot(vm->contexts[i]);
+        print_stats(out, &st);
+        fprintf(out, "===============================\n");
     }
-    
-    return k;
+    fprintf(out, "Replayed %llu events in %f seconds(%.2f M events/s)\n", n, delta, n / delta / 1e6);
+    trace_reader_close(r);
 }
-int WSClock(int owner){
 
-    return LRU(owner);
+/*=============================================
+=            Workloads                        =
+=============================================*/
+
+const Workload* workload_find(const char* key){
+    for(int i = 0; i < N_WORKLOADS; i++){
+        if(strcmp(WORKLOADS[i].key, key) == 0)
+            return &WORKLOADS[i];
+    }
+    return NULL;
 }
 
-void *thread_bubble_sort(void *arg){
-    clock_t t; 
-    t = clock(); 
-    bubble_sort(data_bs.start, data_bs.end , "b");
-    t = clock() - t; 
-    data_bs.delta = ((double)t)/CLOCKS_PER_SEC; // in seconds 
+/*
+    Runs the workload of d and times it, wall time from the monotonic
+    clock and CPU time from the clock of this thread alone. clock() would
+    count every thread of the process.
+*/
+void *thread_workload(void *arg){
+    Data *d = arg;
+    struct timespec w0, w1, c0, c1;
+
+    clock_gettime(CLOCK_MONOTONIC, &w0);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+    d->w->run(d);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+    clock_gettime(CLOCK_MONOTONIC, &w1);
+    d->wall = (w1.tv_sec - w0.tv_sec) + (w1.tv_nsec - w0.tv_nsec) / 1e9;
+    d->cpu += (c1.tv_sec - c0.tv_sec) + (c1.tv_nsec - c0.tv_nsec) / 1e9;  // Parallel sorts add their workers
     pthread_exit(0);
 }
 
-void *thread_quick_sort(void *arg){
-    clock_t t; 
-    t = clock(); 
-    merge_sort(data_qs.start, data_qs.end-1  , "q");
-    t = clock() - t; 
-    data_qs.delta = ((double)t)/CLOCKS_PER_SEC; // in seconds 
-    pthread_exit(0);   
+void run_bubble_sort(Data *d){
+    bubble_sort(d->start, d->end, d->c);
 }
 
-void *thread_merge_sort(void *arg){
-    clock_t t; 
-    t = clock(); 
-    merge_sort(data_ms.start, data_ms.end-1  , "m");
-    t = clock() - t; 
-    data_ms.delta = ((double)t)/CLOCKS_PER_SEC; // in seconds 
-    pthread_exit(0);
+void run_merge_sort(Data *d){
+    merge_sort(d->start, d->end - 1, d->c);
 }
 
-void *thread_index_sort(void *arg){
-    clock_t t; 
-    t = clock(); 
-    merge_sort(data_is.start, data_is.end-1  , "i");
-    t = clock() - t; 
-    data_is.delta = ((double)t)/CLOCKS_PER_SEC; // in seconds 
-    pthread_exit(0);
+void run_quick_sort(Data *d){
+    quick_sort(d->start, d->end - 1, d->c);
 }
 
-void *thread_clock_interrupt(void *arg){
-    
-    int type = pr_validity(page_replacement);
+void run_index_sort(Data *d){
+    index_sort(d->start, d->end - 1, d->c);
+}
 
-    while(!exit_requested && type == 0) {
-        pthread_mutex_lock(&mutex_access);
-        reset_r_bit();
-        pthread_mutex_unlock(&mutex_access);
-        nanosleep((const struct timespec[]){{0, 400000000L}}, NULL); //40ms
-    }
-    
-    pthread_exit(0);
+void run_ext_sort(Data *d){
+    ext_sort(d->start, d->end, d->scratch, d->c);
 }
 
-void reset_r_bit() {
-    for(int i = 0; i < n_entries; i++){
-        VM.page_table[i].referenced = 0;
-    }
+void run_pmerge_sort(Data *d){
+    par_sort(d, pmerge_run);
 }
 
-void apply_aging(){
-    for(int i = 0; i < n_entries; i++){
-        if(VM.page_table[i].present){
-            VM.page_table[i].age++;
-            VM.page_table[i].referenced = 0;
-        }
-    }
+void run_pquick_sort(Data *d){
+    par_sort(d, pquick_run);
+}
+
+void run_generator(Data *d){
+    gen_run(&d->gen, d->c);
 }
 
-void bubble_sort(int s, int e, char* c){
-    for (int i = s; i < e - 1; i++) {
+void bubble_sort(long long s, long long e, Context* c){
+    Cursor a, b;    // a at j, b at j+1
+
+    cursor_open(&a, s, c);
+    cursor_open(&b, s, c);
+    for (long long i = 0; i < e - s - 1; i++) {
         int swap_flag = 0;
-        for (int j = 0; j < e - i - 1; j++) {
-            if (get(j,c) > get(j+1,c)) {
+        cursor_seek(&a, s);
+        cursor_seek(&b, s + 1);
+        for (long long j = s; j < e - i - 1; j++) {
+            if (cursor_read(&a) > cursor_read(&b)) {
                 swap_flag = 1;
-                int temp = get(j,c);
-                set(j, get(j+1,c), c);
-                set(j+1, temp, c); 
+                int temp = cursor_read(&a);
+                cursor_write(&a, cursor_read(&b));
+                cursor_write(&b, temp);
             }
+            cursor_next(&a);
+            cursor_next(&b);
         }
         if (swap_flag == 0)
             break;
     }
+    cursor_close(&a);
+    cursor_close(&b);
 }
 
-void merge(int start, int mid, int end, char* c) {
-    int i = 0, j = 0, k;
-    int n_left = mid - start + 1;
-    int n_right = end - mid;
-    int left[n_left], right[n_right];
+void merge(long long start, long long mid, long long end, Context* c) {
+    long long i = 0, j = 0, k;
+    long long n_left = mid - start + 1;
+    long long n_right = end - mid;
+    int n = 0;
+    int *left, *right, out[MERGE_CHUNK];
 
-    for (int n = 0; n < n_left; n++)
-        left[n] = get(start+n, c);
-    for (int n = 0; n < n_right; n++)
-        right[n] = get(mid+1+n, c);
+    // Halves on the heap, a stack array overflows on large ranges
+    left = malloc(sizeof(int) * (n_left + n_right));
+    if(left == NULL) _errExit("malloc @merge");
+    right = left + n_left;
+
+    get_range(start, n_left, left, c);
+    get_range(mid+1, n_right, right, c);
 
     k = start;
 
-    while (i < n_left && j < n_right) {
-        if (left[i] <= right[j])
-            set(k++, left[i++], c);
-        else 
-            set(k++, right[j++], c);
+    // Merged integers are written back a chunk at a time
+    while (i < n_left || j < n_right) {
+        if (j >= n_right || (i < n_left && left[i] <= right[j]))
+            out[n++] = left[i++];
+        else
+            out[n++] = right[j++];
+
+        if (n == MERGE_CHUNK) {
+            set_range(k, n, out, c);
+            k += n;
+            n = 0;
+        }
     }
 
-    while (i < n_left) 
-        set(k++, left[i++], c);
-
-    while (j < n_right)
-        set(k++, right[j++], c);
+    if (n > 0)
+        set_range(k, n, out, c);
+    free(left);
 }
 
-void merge_sort(int left, int right, char* c){
+void merge_sort(long long left, long long right, Context* c){
   if (left < right) {
-    int mid = left + (right - left) / 2;
+    long long mid = left + (right - left) / 2;
     merge_sort(left, mid, c);
     merge_sort(mid + 1, right, c);
     merge(left, mid, right, c);
   }
 }
-void quick_sort(int low, int high, char* c){
+void quick_sort(long long low, long long high, Context* c){
     if(low < high) {
-        int pivot = partition(low,high,c);
+        long long pivot = partition(low,high,c);
         quick_sort(low, pivot - 1, c);
         quick_sort(pivot + 1, high, c);
     }
 }
 
-int partition(int low, int high, char* c){
+long long partition(long long low, long long high, Context* c){
     int pivot = get(high,c);
-    int i = low -1;
-
-    for(int j = low; j < high; j++) {
-        if (get(j,c) <= pivot) {
-          i++;
-          swap(i, j, c);
+    long long i = low -1;
+    long long j = low;
+    Span sp;
+
+    // Scan through pinned pages, swaps inside the pinned page are done in place
+    while(j < high) {
+        sp = pin(j, PIN_READ, c);
+        long long end = (sp.start + sp.len < high) ? sp.start + sp.len : high;
+
+        for(; j < end; j++) {
+            sp.n_reads++;
+            if (sp.data[j - sp.start] <= pivot) {
+                i++;
+                if (i >= sp.start) {
+                    int temp = sp.data[i - sp.start];
+                    sp.data[i - sp.start] = sp.data[j - sp.start];
+                    sp.data[j - sp.start] = temp;
+                    sp.n_reads += 2;
+                    sp.n_writes += 2;
+                }
+                else {
+                    unpin(&sp, c);
+                    swap(i, j, c);
+                    j++;
+                    break;
+                }
+            }
         }
+        if (sp.data != NULL)
+            unpin(&sp, c);
     }
     swap(i+1, high, c);
     return i + 1;
 }
 
-void swap(int i, int j, char* c){
+void swap(long long i, long long j, Context* c){
     int temp = get(i,c);
     set(i, get(j,c), c);
     set(j, temp, c);
 }
 
-void index_sort(int s, int e, char* c) {
-    int low_ind = s;
-    int up_ind = e;
-    int counter1 = 0;
-    int counter2 = 0;
-    int j;
+void index_sort(long long s, long long e, Context* c) {
+    long long low_ind = s;
+    long long up_ind = e;
+    long long counter1 = 0;
+    long long counter2 = 0;
+    long long j;
+    Cursor pos, cur;    // pos at low_ind/up_ind, cur scans j
+
+    cursor_open(&pos, low_ind, c);
+    cursor_open(&cur, low_ind, c);
     while(low_ind < up_ind){
-                for(j = low_ind+1; j < up_ind; j++){
-            if(get(low_ind, c) > get(j, c))
+        cursor_seek(&pos, low_ind);
+        cursor_seek(&cur, low_ind+1);
+        for(j = low_ind+1; j < up_ind; j++){
+            if(cursor_read(&pos) > cursor_read(&cur))
                 counter1++;
+            cursor_next(&cur);
         }
         if(counter1 > 0){
             int t = get(low_ind, c);
@@ -1064,10 +816,13 @@ void index_sort(int s, int e, char* c) {
         }
 
         j = up_ind - 1;
+        cursor_seek(&pos, up_ind);
+        cursor_seek(&cur, j);
         while(j >= low_ind){
-            if(get(up_ind,c) < get(j,c)){
+            if(cursor_read(&pos) < cursor_read(&cur)){
                 counter2++;
             }
+            cursor_prev(&cur);
             j--;
         }
 
@@ -1082,93 +837,297 @@ void index_sort(int s, int e, char* c) {
             up_ind--;
         }
     }
+    cursor_close(&pos);
+    cursor_close(&cur);
 }
 
+/*
+    Sorts [d->start, d->end) on a work stealing pool of the contexts in
+    d->workers, run is the task body of the sort
+*/
+void par_sort(Data *d, void (*run)(Task*, Worker*)){
+    Pool *p = pool_create(d->workers, d->n_workers);
+
+    pool_run(p, task_new(run, NULL, d->start, d->end - 1));
+    for(int i = 0; i < p->n_workers; i++){
+        d->n_tasks += p->workers[i].n_tasks;
+        d->n_steals += p->workers[i].n_steals;
+        if(i > 0)   // Worker 0 is this thread, thread_workload times it
+            d->cpu += p->workers[i].cpu;
+    }
+    pool_destroy(p);
+}
 
-int is_sorted(int s, int e){
-    if (s < 0 || s > e || e > n_words) _errExit("Index out of range @print_disk");
-
-    for(int i = s; i < e-1; i++) {
-        if (get(i, "c") > get(i+1,"c"))
-            return -1;
+// Parallel merge sort of [t->lo, t->hi], halves are tasks and merged in the join
+void pmerge_run(Task *t, Worker *w){
+    if (t->hi - t->lo + 1 <= PAR_GRAIN) {
+        merge_sort(t->lo, t->hi, w->c);
+        return;
     }
-    return 0;
+    t->mid = t->lo + (t->hi - t->lo) / 2;
+    t->join = pmerge_join;
+    pool_spawn(w, t, task_new(pmerge_run, NULL, t->mid + 1, t->hi));
+    pool_spawn(w, t, task_new(pmerge_run, NULL, t->lo, t->mid));
+}
 
+void pmerge_join(Task *t, Worker *w){
+    merge(t->lo, t->mid, t->hi, w->c);
 }
-void print_disk(int s, int e){
-    if (s < 0 || s > e || e > n_words) _errExit("Index out of range @print_disk");
 
+// Parallel quick sort of [t->lo, t->hi], the sides of each partition are tasks
+void pquick_run(Task *t, Worker *w){
+    long long pivot;
 
-    printf("==========Disk[%d, %d]============\n", s, e);
-    for(int i = s; i < e; i++) {
-        printf("%d\n",get(i,"c"));
+    if (t->hi - t->lo + 1 <= PAR_GRAIN) {
+        quick_sort(t->lo, t->hi, w->c);
+        return;
     }
-    printf("==================================");
+    pivot = partition(t->lo, t->hi, w->c);
+    pool_spawn(w, t, task_new(pquick_run, NULL, pivot + 1, t->hi));
+    pool_spawn(w, t, task_new(pquick_run, NULL, t->lo, pivot - 1));
 }
 
-int compare_time(struct timespec t1, struct timespec t2){
-    if(t1.tv_sec == t2.tv_sec && t1.tv_nsec == t2.tv_nsec){
-        //debug("t1 == t2\n");
-        return 0;
-    }
-    else if(t1.tv_sec >= t2.tv_sec && t1.tv_nsec > t2.tv_nsec){
-        //debug("t1 > t2\n");
-        return 1;
-    }
-    else{
-        //debug("t1 < t2\n");
-        return -1;
-    }
-}
+/*
+    Reader of one sorted run in ext_merge, buffers the page the run
+    is at
+*/
+typedef struct{
+    long long pos, end;     // Next integer to load, end of the run
+    int* buf;               // f_size integers
+    int i, n;               // Next buffered integer, # buffered
+} RunReader;
 
-int algorithm(int owner){
-    int type = -1;
+// Heap node of ext_merge, smallest head of the runs at the root
+typedef struct{
+    int value;
+    int run;
+} RunHead;
 
-    for(int i = 0; i < PR_N; i++){
-        if(strncmp(page_replacement, PR_TYPES[i], strlen(PR_TYPES[i])) == 0)
-            type = i;
+int cmp_int(const void *a, const void *b){
+    int x = *(const int*) a, y = *(const int*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ *  External merge sort of [s, e) with scratch[0, e - s) as the second
+ *  buffer. Runs as long as the frames of c are sorted in memory, then
+ *  merged k at a time with a page sized buffer per run and one for the
+ *  output, so every pass reads and writes the range sequentially once.
+ *  Runs go to whichever side makes the last pass end in [s, e).
+ */
+void ext_sort(long long s, long long e, long long scratch, Context* c){
+    long long n = e - s, frames = ctx_frames(c), run, n_runs, dst;
+    int k, passes = 0;
+    int* buf;
+
+    if (n <= 1)
+        return;
+
+    // One frame per run being merged and one for the output
+    k = (frames - 1 > 2) ? frames - 1 : 2;
+    run = frames * c->vm->f_size;
+    if (run > n) run = n;
+
+    n_runs = (n + run - 1) / run;
+    for (long long r = n_runs; r > 1; r = (r + k - 1) / k)
+        passes++;
+    dst = (passes % 2 == 0) ? s : scratch;
+
+    // Run formation
+    buf = malloc(sizeof(int) * run);
+    if (buf == NULL) _errExit("malloc @ext_sort");
+    for (long long i = 0; i < n; i += run) {
+        long long len = (n - i < run) ? n - i : run;
+        get_range(s + i, len, buf, c);
+        qsort(buf, len, sizeof(int), cmp_int);
+        set_range(dst + i, len, buf, c);
     }
+    free(buf);
 
-    switch(type) {
-        case 0 : return NRU(owner); 
-        case 1 : return FIFO(owner);
-        case 2 : return SC(owner);
-        case 3 : return LRU(owner);
-        case 4 : return WSClock(owner);
-        default: _errExit("Invalid algorithm @algorithm");
+    // Merge passes, runs grow k times each pass
+    for (int p = 0; p < passes; p++) {
+        long long src = dst;
+        dst = (src == s) ? scratch : s;
+        run = ext_merge(src, dst, n, run, k, c);
     }
 }
 
-// Returns a physical address if a free frame available, -1 otherwise
+/**
+ *  One merge pass of ext_sort, groups of k runs of length run in
+ *  src[0, n) are merged into dst. A last group of a single run is only
+ *  copied. Returns the new run length.
+ */
+long long ext_merge(long long src, long long dst, long long n, long long run, int k, Context* c){
+    int f_size = c->vm->f_size;
+    RunReader *in = malloc(sizeof(RunReader) * k);
+    RunHead *heap = malloc(sizeof(RunHead) * k);
+    int *bufs = malloc(sizeof(int) * f_size * (k + 1));
+    int *out = bufs + (long long) f_size * k;
+
+    if (in == NULL || heap == NULL || bufs == NULL) _errExit("malloc @ext_merge");
+
+    for (long long g = 0; g < n; g += run * k) {
+        long long o = dst + g;  // Next output position
+        int n_heap = 0, n_out = 0;
+
+        if (g + run >= n) {     // Nothing to merge with
+            copy_range(dst + g, src + g, n - g, c);
+            break;
+        }
+
+        // Open the runs of the group and push their heads
+        for (int r = 0; r < k && g + r * run < n; r++) {
+            RunReader *rd = &in[r];
+            rd->pos = src + g + r * run;
+            rd->end = (g + (r + 1) * run < n) ? src + g + (r + 1) * run : src + n;
+            rd->buf = bufs + (long long) f_size * r;
+            rd->i = rd->n = 0;
+
+            // Fill to the end of the page so later loads are whole pages
+            rd->n = f_size - rd->pos % f_size;
+            if (rd->n > rd->end - rd->pos) rd->n = rd->end - rd->pos;
+            get_range(rd->pos, rd->n, rd->buf, c);
+            rd->pos += rd->n;
+
+            int h = n_heap++;
+            while (h > 0 && heap[(h - 1) / 2].value > rd->buf[0]) {
+                heap[h] = heap[(h - 1) / 2];
+                h = (h - 1) / 2;
+            }
+            heap[h].value = rd->buf[0];
+            heap[h].run = r;
+        }
+
+        while (n_heap > 0) {
+            RunReader *rd = &in[heap[0].run];
+            RunHead top = heap[0];
+
+            out[n_out++] = top.value;
+            // The output buffer ends at page boundaries of dst too
+            if (n_out == f_size - (o % f_size)) {
+                set_range(o, n_out, out, c);
+                o += n_out;
+                n_out = 0;
+            }
+
+            // Next head of the run, the run leaves the heap when done
+            if (++rd->i == rd->n && rd->pos < rd->end) {
+                rd->n = (rd->end - rd->pos < f_size) ? rd->end - rd->pos : f_size;
+                get_range(rd->pos, rd->n, rd->buf, c);
+                rd->pos += rd->n;
+                rd->i = 0;
+            }
+            if (rd->i < rd->n) top.value = rd->buf[rd->i];
+            else               top = heap[--n_heap];
+
+            // Sift down
+            int h = 0;
+            while (2 * h + 1 < n_heap) {
+                int m = 2 * h + 1;
+                if (m + 1 < n_heap && heap[m + 1].value < heap[m].value) m++;
+                if (heap[m].value >= top.value) break;
+                heap[h] = heap[m];
+                h = m;
+            }
+            if (n_heap > 0) heap[h] = top;
+        }
 
-int find_free_addr(){
-    for(int i = 0; i < n_pframes; i++){
-        if (bitmap[i] == 0)
-           return i;
+        if (n_out > 0)
+            set_range(o, n_out, out, c);
     }
-    return -1;
+
+    free(in);
+    free(heap);
+    free(bufs);
+    return run * k;
 }
 
-int pr_validity(char* type){
-    for(int i = 0; i < PR_N; i++){
-        if(strncmp(type, PR_TYPES[i], strlen(PR_TYPES[i])) == 0)
-            return i;
+int is_sorted(long long s, long long e, Context* c){
+    if (s < 0 || s > e || e > c->vm->n_words) _errExit("Index out of range @print_disk");
+
+    long long i = s;
+    int prev = 0, result = 0;
+    Span sp;
+
+    while(i < e && result == 0) {
+        sp = pin(i, PIN_READ, c);
+        long long end = (sp.start + sp.len < e) ? sp.start + sp.len : e;
+
+        for(; i < end; i++) {
+            int cur = sp.data[i - sp.start];
+            if (i > s) {
+                sp.n_reads += 2;    // Same count as comparing get(i) and get(i+1)
+                if (prev > cur) {
+                    result = -1;
+                    break;
+                }
+            }
+            prev = cur;
+        }
+        unpin(&sp, c);
     }
-    return -1;
-}
+    return result;
 
-int ap_validity(char* type){
-    for(int i = 0; i < AP_N; i++){
-        if(strncmp(type, AP_TYPES[i], strlen(AP_TYPES[i])) == 0)
-            return i;
+}
+void print_disk(long long s, long long e, Context* c){
+    if (s < 0 || s > e || e > c->vm->n_words) _errExit("Index out of range @print_disk");
+
+    long long i = s;
+    Span sp;
+
+    printf("==========Disk[%lld, %lld]============\n", s, e);
+    while(i < e) {
+        sp = pin(i, PIN_READ, c);
+        long long end = (sp.start + sp.len < e) ? sp.start + sp.len : e;
+        for(; i < end; i++) {
+            printf("%d\n", sp.data[i - sp.start]);
+            sp.n_reads++;
+        }
+        unpin(&sp, c);
     }
-    return -1;
+    printf("==================================");
 }
 
 void print_usage(){
     printf("\n==========================================\n");
-    printf("Usage:\n./sortArrays"
-    " frameSize numPhysical numVirtual pageReplacement allocPolicy pageTablePrintInt diskFileName.dat\n\n");
+    printf("Usage:\n./sortArrays [-G frameSize,numPhysical,numVirtual] [-j jobs] [-m] [-s budget] [-a]\n"
+    "            [-r trace | -p trace [-f]] [-w name[:threads]]... [-g workload]... [-t workers]\n\n");
+
+    printf("Runs the experiment sweep, %d tests for every PR/AP pair\n"
+    "-G  geometry of the first test as powers of 2, integers per frame,\n"
+    "    physical and virtual frames(%d,%d,%d). Every next test doubles the\n"
+    "    frame size and halves both frame counts. frameSize + numVirtual\n"
+    "    may go past 31 for VMs over 2^31 integers\n"
+    "-j  # of tests run at the same time(one per online core)\n"
+    "-m  miss ratio curve analysis, one LRU run per frame size\n"
+    "-s  sampled(SHARDS) miss ratio curve tracking at most budget pages,\n"
+    "    checked against the exact curve with -m\n"
+    "-a  every policy in one LRU run per frame size, the others are\n"
+    "    simulated on the same page stream without data movement\n"
+    "-r  record every access of test <id> to trace.<id>\n"
+    "-p  replay a recorded trace instead of the sorts, on every PR/AP\n"
+    "    at the geometry of the trace. The traced interleaving is kept\n"
+    "    unless -f is given\n"
+    "-w  workload to run instead of the four sorts, with threads\n"
+    "    instances(1). Repeat for more, each thread gets an equal slice\n"
+    "    of the VM. One of bubble, merge, quick, index, ext(external\n"
+    "    merge sort of half the slice, the other half is its scratch),\n"
+    "    pmerge, pquick(parallel merge/quick sort)\n"
+    "-t  # of threads of each parallel sort(4), they share the owner\n"
+    "    of the sort for local allocation and steal work from each other\n"
+    "-g  synthetic workload thread, repeat for more threads.\n"
+    "    pattern[:key=value,...] with pattern one of\n"
+    "    uniform, zipf, seq, loop, hotcold, phase and keys\n"
+    "    ops     accesses(default one per word, 4 passes for loop)\n"
+    "    write   share of writes(0.25)\n"
+    "    theta   zipf skew, below 1(0.99)\n"
+    "    hot     hotcold/phase hot set share of the range(0.1)\n"
+    "    prob    share of accesses to the hot set(0.9)\n"
+    "    phase   accesses before the hot set moves(ops/4)\n"
+    "    loop    loop length in words(1.5 x RAM)\n"
+    "    lo, hi  range as fractions of the VM(own slice)\n"
+    "    seed    random seed(0)\n"
+    "    e.g. -g zipf:theta=0.8 -g loop -g phase:hot=0.05,write=0.5\n\n", N_TESTS, GEOMETRY_FS, GEOMETRY_NP, GEOMETRY_NV);
 
     printf("Supported page replacement methods:\n");
     for(int i = 0; i < PR_N; i++)
@@ -1189,31 +1148,3 @@ void print_array(int* arr, int n){
         printf("%d\n",arr[i]);
     printf("%d]\n",arr[n-1]);
 }
-
-
-void print_entry(Entry e){
-    debug("%-12s%-12s%-12s%-12s%-12s%-7s\n", "Virtual", "Physical", "Present", "Modified", "Referenced", "Owner");
-    debug("%-12d%-12d%-12d%-12d%-12d%-7d\n",
-                                    e.addr_virtual,
-                                    e.addr_physical,
-                                    e.present,
-                                    e.modified,
-                                    e.referenced,
-                                    e.owner);
-    debug("=================================\n");
-}
-
-void print_pt(){
-    printf("=========================================================\n");
-    printf("%-12s%-12s%-12s%-12s%-12s%-7s\n", "Virtual", "Physical", "Present", "Modified", "Referenced", "Owner");
-    for(int i = 0; i < n_entries; i++){
-        printf("%-12d%-12d%-12d%-12d%-12d%-7d\n",
-                                    VM.page_table[i].addr_virtual,
-                                    VM.page_table[i].addr_physical,
-                                    VM.page_table[i].present,
-                                    VM.page_table[i].modified,
-                                    VM.page_table[i].referenced,
-                                    VM.page_table[i].owner);
-    }
-    printf("=========================================================\n");
-}
\ No newline at end of file
@@ -0,0 +1,477 @@
+//
+//  mrc.c
+//  Virtual Memory Part 3
+//
+//  Created by Muhammed Okumuş on 23.06.2020.
+//  Copyright 2020 Muhammed Okumus. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mrc.h"
+
+#define _errExit(msg) do{ perror(msg); exit(EXIT_FAILURE); } while(0)
+
+/*=============================================
+=            Fenwick Tree                     =
+=============================================*/
+
+static inline void fw_add(Mrc *m, long long slot, int v){
+    for(long long i = slot + 1; i <= m->cap; i += i & -i)
+        m->tree[i] += v;
+}
+
+// Marks in slots [0, slot]
+static inline long long fw_prefix(Mrc *m, long long slot){
+    long long sum = 0;
+    for(long long i = slot + 1; i > 0; i -= i & -i)
+        sum += m->tree[i];
+    return sum;
+}
+
+/*
+    Moves the live marks to the first slots keeping their order and
+    rebuilds the tree in linear time. At most n_pages marks are live so
+    at least half the slots are free afterwards.
+*/
+static void mrc_compact(Mrc *m){
+    long long k = 0;
+
+    for(long long s = 0; s < m->top; s++){
+        long long p = m->slot_page[s];
+        if(p == -1)
+            continue;
+        m->slot_page[s] = -1;
+        m->slot_page[k] = p;
+        m->last[p] = k++;
+    }
+    m->top = k;
+
+    memset(m->tree, 0, sizeof(int) * (m->cap + 1));
+    for(long long i = 1; i <= k; i++)
+        m->tree[i] = 1;
+    for(long long i = 1; i <= m->cap; i++){
+        long long j = i + (i & -i);
+        if(j <= m->cap) m->tree[j] += m->tree[i];
+    }
+}
+
+/*=============================================
+=            Miss Ratio Curve                 =
+=============================================*/
+
+Mrc* mrc_create(long long n_pages){
+    Mrc *m = calloc(1, sizeof(Mrc));
+    if(m == NULL) _errExit("calloc @mrc_create");
+
+    m->n_pages = n_pages;
+    m->cap = 2 * n_pages;
+    m->tree = calloc(m->cap + 1, sizeof(int));
+    m->slot_page = malloc(sizeof(long long) * m->cap);
+    m->last = malloc(sizeof(long long) * n_pages);
+    m->hist = calloc(n_pages + 1, sizeof(unsigned long long));
+    if(m->tree == NULL || m->slot_page == NULL || m->last == NULL || m->hist == NULL)
+        _errExit("malloc @mrc_create");
+
+    memset(m->slot_page, -1, sizeof(long long) * m->cap);
+    memset(m->last, -1, sizeof(long long) * n_pages);
+    return m;
+}
+
+void mrc_free(Mrc *m){
+    if(m == NULL)
+        return;
+    free(m->tree);
+    free(m->slot_page);
+    free(m->last);
+    free(m->hist);
+    free(m);
+}
+
+/**
+ *  Records an access to page, O(log n_pages) amortized. The access is a
+ *  hit for every LRU memory of at least its stack distance frames.
+ *  Returns the stack distance, 0 for a first access.
+ */
+long long mrc_access(Mrc *m, long long page){
+    long long s = m->last[page], d = 0;
+
+    m->n_accesses++;
+    if(s == -1){
+        m->n_cold++;
+        m->live++;
+    }
+    else{
+        // Pages referenced since, plus the page itself
+        d = m->live - fw_prefix(m, s - 1);
+        m->hist[d]++;
+        fw_add(m, s, -1);
+        m->slot_page[s] = -1;
+    }
+
+    if(m->top == m->cap)
+        mrc_compact(m);
+
+    s = m->top++;
+    fw_add(m, s, 1);
+    m->slot_page[s] = page;
+    m->last[page] = s;
+    return d;
+}
+
+// Drops page from the stack, its next access is a first access again
+void mrc_forget(Mrc *m, long long page){
+    long long s = m->last[page];
+
+    if(s == -1)
+        return;
+    fw_add(m, s, -1);
+    m->slot_page[s] = -1;
+    m->last[page] = -1;
+    m->live--;
+}
+
+/**
+ *  Fills misses[c] with the LRU misses of a memory of c frames for every
+ *  c in [0, n_pages]. misses must hold n_pages + 1 counters.
+ */
+void mrc_curve(Mrc *m, unsigned long long* misses){
+    unsigned long long beyond = 0;  // Accesses at distance > c
+
+    for(long long c = m->n_pages; c >= 0; c--){
+        misses[c] = m->n_cold + beyond;
+        beyond += m->hist[c];
+    }
+}
+
+static void mrc_row(Mrc *m, FILE *out, unsigned long long* misses, long long c, int f_size, const char* tag){
+    fprintf(out, "%10lld %10.1f %14llu %10.6f %s\n", c, c * f_size * sizeof(int) / 1024.0,
+            misses[c], m->n_accesses ? (double) misses[c] / m->n_accesses : 0, tag);
+}
+
+/*
+    Prints the curve at power of 2 frame counts up to the pages seen(the
+    curve is flat after) and at mark, the frame count of the simulated
+    memory, tagged with '*'.
+*/
+void mrc_print(Mrc *m, FILE *out, long long mark, int f_size){
+    int marked = 0;
+    unsigned long long* misses = malloc(sizeof(unsigned long long) * (m->n_pages + 1));
+    if(misses == NULL) _errExit("malloc @mrc_print");
+    mrc_curve(m, misses);
+
+    fprintf(out, "LRU miss ratio curve, %llu accesses to %lld pages\n", m->n_accesses, m->live);
+    fprintf(out, "%10s %10s %14s %10s\n", "Frames", "RAM(KB)", "Misses", "Ratio");
+    for(long long c = 1; m->live > 0; c <<= 1){
+        long long row = (c < m->live) ? c : m->live;
+
+        if(!marked && mark < row){
+            mrc_row(m, out, misses, mark, f_size, "*");
+            marked = 1;
+        }
+        mrc_row(m, out, misses, row, f_size, row == mark ? "*" : "");
+        marked |= (row == mark);
+        if(row == m->live)
+            break;
+    }
+    if(!marked && mark <= m->n_pages)
+        mrc_row(m, out, misses, mark, f_size, "*");
+    free(misses);
+}
+
+/**
+ *  Writes the full curve as csv, one line per frame count up to the
+ *  pages seen(the curve is flat after). Returns -1 if path can not be
+ *  written.
+ */
+int mrc_write(Mrc *m, const char* path, int f_size){
+    unsigned long long* misses;
+    FILE *f = fopen(path, "w");
+    if(f == NULL)
+        return -1;
+
+    misses = malloc(sizeof(unsigned long long) * (m->n_pages + 1));
+    if(misses == NULL) _errExit("malloc @mrc_write");
+    mrc_curve(m, misses);
+
+    fprintf(f, "frames,ram_kb,misses,miss_ratio\n");
+    for(long long c = 1; c <= m->live; c++)
+        fprintf(f, "%lld,%.2f,%llu,%.6f\n", c, c * f_size * sizeof(int) / 1024.0,
+                misses[c], m->n_accesses ? (double) misses[c] / m->n_accesses : 0);
+
+    free(misses);
+    fclose(f);
+    return 0;
+}
+
+/*=============================================
+=            SHARDS Sampling                  =
+=============================================*/
+
+// Page number mixer(splitmix64 finalizer) reduced to [0, SHARDS_P)
+static inline uint32_t shards_hash(long long page){
+    uint64_t x = (uint64_t) page;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (uint32_t) (x & (SHARDS_P - 1));
+}
+
+static long long shards_slot(Shards *sh, long long page){
+    long long i = shards_hash(page) & sh->table_mask;
+
+    while(sh->keys[i] != -1 && sh->keys[i] != page)
+        i = (i + 1) & sh->table_mask;
+    return i;
+}
+
+// Removes slot i of the table, later keys of the probe run are moved back
+static void shards_unlink(Shards *sh, long long i){
+    long long j = i;
+
+    sh->keys[i] = -1;
+    while(1){
+        j = (j + 1) & sh->table_mask;
+        if(sh->keys[j] == -1)
+            return;
+        long long home = shards_hash(sh->keys[j]) & sh->table_mask;
+        // Key at j can fill the hole if its home is not in (i, j]
+        if((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j))){
+            sh->keys[i] = sh->keys[j];
+            sh->ids[i] = sh->ids[j];
+            sh->keys[j] = -1;
+            i = j;
+        }
+    }
+}
+
+static void heap_swap(Shards *sh, long long a, long long b){
+    long long p = sh->heap_page[a];
+    uint32_t h = sh->heap_hash[a];
+    sh->heap_page[a] = sh->heap_page[b];
+    sh->heap_hash[a] = sh->heap_hash[b];
+    sh->heap_page[b] = p;
+    sh->heap_hash[b] = h;
+}
+
+static void heap_push(Shards *sh, long long page, uint32_t hash){
+    long long i = sh->n_tracked++;
+
+    sh->heap_page[i] = page;
+    sh->heap_hash[i] = hash;
+    while(i > 0 && sh->heap_hash[(i - 1) / 2] < sh->heap_hash[i]){
+        heap_swap(sh, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heap_pop(Shards *sh){
+    long long i = 0, n = --sh->n_tracked;
+
+    heap_swap(sh, 0, n);
+    while(1){
+        long long l = 2 * i + 1, r = l + 1, big = i;
+        if(l < n && sh->heap_hash[l] > sh->heap_hash[big]) big = l;
+        if(r < n && sh->heap_hash[r] > sh->heap_hash[big]) big = r;
+        if(big == i)
+            break;
+        heap_swap(sh, i, big);
+        i = big;
+    }
+}
+
+/*
+    Histogram bucket of a distance, rounded up for distances and down for
+    frame counts. The first half of the buckets are a frame each where the
+    curve changes fastest, the rest spread over the address space.
+*/
+static long long shards_bin(Shards *sh, double d, int up){
+    const long long half = SHARDS_BINS / 2;
+    long long b;
+
+    if(d <= half)
+        b = up ? (long long) ceil(d) : (long long) d;
+    else
+        b = half + (up ? (long long) ceil((d - half) / sh->bin_width) : (long long) ((d - half) / sh->bin_width));
+    return b > SHARDS_BINS + 1 ? SHARDS_BINS + 1 : b;
+}
+
+/**
+ *  Creates a sampler for an address space of n_pages pages tracking at
+ *  most budget of them. Sampling starts at rate 1 and drops as pages
+ *  beyond the budget show up.
+ */
+Shards* shards_create(long long n_pages, long long budget){
+    Shards *sh = calloc(1, sizeof(Shards));
+    long long table = 2;
+
+    if(sh == NULL) _errExit("calloc @shards_create");
+    while(table < 2 * budget)
+        table <<= 1;
+
+    sh->budget = budget;
+    sh->threshold = SHARDS_P;
+    sh->stack = mrc_create(budget);
+    sh->table_mask = table - 1;
+    sh->keys = malloc(sizeof(long long) * table);
+    sh->ids = malloc(sizeof(long long) * table);
+    sh->heap_page = malloc(sizeof(long long) * budget);
+    sh->heap_hash = malloc(sizeof(uint32_t) * budget);
+    sh->free_ids = malloc(sizeof(long long) * budget);
+    sh->n_pages = n_pages;
+    sh->bin_width = (n_pages + SHARDS_BINS / 2 - 1) / (SHARDS_BINS / 2);
+    if(sh->bin_width < 1) sh->bin_width = 1;
+    sh->hist = calloc(SHARDS_BINS + 2, sizeof(double));
+    if(sh->keys == NULL || sh->ids == NULL || sh->heap_page == NULL || sh->heap_hash == NULL ||
+       sh->free_ids == NULL || sh->hist == NULL)
+        _errExit("malloc @shards_create");
+
+    memset(sh->keys, -1, sizeof(long long) * table);
+    for(long long i = 0; i < budget; i++)
+        sh->free_ids[sh->n_free++] = budget - 1 - i;
+    return sh;
+}
+
+void shards_free(Shards *sh){
+    if(sh == NULL)
+        return;
+    mrc_free(sh->stack);
+    free(sh->keys);
+    free(sh->ids);
+    free(sh->heap_page);
+    free(sh->heap_hash);
+    free(sh->free_ids);
+    free(sh->hist);
+    free(sh);
+}
+
+/**
+ *  Records an access to page. Pages outside the sample cost one hash,
+ *  sampled ones O(log budget).
+ */
+void shards_access(Shards *sh, long long page){
+    uint32_t hash = shards_hash(page);
+    long long i, id, d;
+    double w;
+
+    sh->n_accesses++;
+    if(hash >= sh->threshold)
+        return;
+
+    i = shards_slot(sh, page);
+    if(sh->keys[i] == -1){
+        if(sh->n_tracked == sh->budget){
+            // Over budget, the largest hash leaves the sample for good
+            if(hash >= sh->heap_hash[0]){
+                sh->threshold = hash;
+                return;
+            }
+            long long old = sh->heap_page[0];
+            long long j = shards_slot(sh, old);
+
+            sh->threshold = sh->heap_hash[0];
+            mrc_forget(sh->stack, sh->ids[j]);
+            sh->free_ids[sh->n_free++] = sh->ids[j];
+            shards_unlink(sh, j);
+            heap_pop(sh);
+            i = shards_slot(sh, page);
+        }
+        sh->keys[i] = page;
+        sh->ids[i] = sh->free_ids[--sh->n_free];
+        heap_push(sh, page, hash);
+    }
+    id = sh->ids[i];
+
+    sh->n_sampled++;
+    w = (double) SHARDS_P / sh->threshold;  // Inverse of the sampling rate
+    sh->n_weight += w;
+    d = mrc_access(sh->stack, id);
+    if(d == 0)
+        sh->n_cold += w;
+    else{
+        // The d - 1 other sampled pages stand for (d - 1) * w pages
+        sh->hist[shards_bin(sh, 1 + (d - 1) * w, 1)] += w;
+    }
+}
+
+// Estimated LRU miss ratio of frames frames, tail[b] is the weight in buckets above b
+static double shards_ratio(Shards *sh, double* tail, long long frames){
+    long long b = shards_bin(sh, frames, 0);
+
+    if(sh->n_weight == 0)
+        return 0;
+    return (sh->n_cold + tail[b]) / sh->n_weight;
+}
+
+static void shards_row(Shards *sh, FILE *out, double* tail, Mrc *exact, unsigned long long* misses,
+                       long long c, int f_size, const char* tag){
+    double r = shards_ratio(sh, tail, c);
+
+    fprintf(out, "%10lld %10.1f %10.6f", c, c * f_size * sizeof(int) / 1024.0, r);
+    if(exact != NULL){
+        double e = exact->n_accesses ? (double) misses[c] / exact->n_accesses : 0;
+        fprintf(out, " %10.6f %+10.6f", e, r - e);
+    }
+    fprintf(out, " %s\n", tag);
+}
+
+/*
+    Prints the estimated curve like mrc_print. With exact given(both
+    recorded the same stream) the exact ratio and the error are printed
+    too, followed by mean and max absolute error over every frame count.
+*/
+void shards_print(Shards *sh, FILE *out, long long mark, int f_size, Mrc *exact){
+    double* tail = calloc(SHARDS_BINS + 3, sizeof(double));
+    unsigned long long* misses = NULL;
+    long long pages;
+    int marked = 0;
+
+    if(tail == NULL) _errExit("calloc @shards_print");
+    for(long long b = SHARDS_BINS; b >= 0; b--)
+        tail[b] = tail[b + 1] + sh->hist[b + 1];
+
+    // Distinct pages estimated from the cold misses
+    pages = (long long) (sh->n_cold + 0.5);
+    if(pages > sh->n_pages) pages = sh->n_pages;
+    if(exact != NULL){
+        misses = malloc(sizeof(unsigned long long) * (exact->n_pages + 1));
+        if(misses == NULL) _errExit("malloc @shards_print");
+        mrc_curve(exact, misses);
+    }
+
+    fprintf(out, "SHARDS miss ratio curve, %llu of %llu accesses sampled, rate %f, %lld pages tracked\n",
+            sh->n_sampled, sh->n_accesses, (double) sh->threshold / SHARDS_P, sh->n_tracked);
+    fprintf(out, "%10s %10s %10s", "Frames", "RAM(KB)", "Ratio");
+    if(exact != NULL)
+        fprintf(out, " %10s %10s", "Exact", "Error");
+    fprintf(out, "\n");
+    for(long long c = 1; pages > 0; c <<= 1){
+        long long row = (c < pages) ? c : pages;
+
+        if(!marked && mark < row){
+            shards_row(sh, out, tail, exact, misses, mark, f_size, "*");
+            marked = 1;
+        }
+        shards_row(sh, out, tail, exact, misses, row, f_size, row == mark ? "*" : "");
+        marked |= (row == mark);
+        if(row == pages)
+            break;
+    }
+    if(!marked && mark <= sh->n_pages)
+        shards_row(sh, out, tail, exact, misses, mark, f_size, "*");
+
+    if(exact != NULL){
+        double sum = 0, max = 0;
+        long long n = exact->live;
+
+        for(long long c = 1; c <= n; c++){
+            double e = fabs(shards_ratio(sh, tail, c) - (double) misses[c] / exact->n_accesses);
+            sum += e;
+            if(e > max) max = e;
+        }
+        fprintf(out, "SHARDS error over %lld frame counts: mean %f, max %f\n", n, n ? sum / n : 0, max);
+        free(misses);
+    }
+    free(tail);
+}
@@ -0,0 +1,88 @@
+//
+//  mrc.h
+//  Virtual Memory Part 3
+//
+//  Created by Muhammed Okumuş on 23.06.2020.
+//  Copyright 2020 Muhammed Okumus. All rights reserved.
+//
+
+#ifndef MRC_H
+#define MRC_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define SHARDS_P (1u << 24)     // Modulus of the sampling hash
+#define SHARDS_BINS 4096        // Histogram buckets of a sampled curve
+
+/*===========================================
+=            Miss Ratio Curve               =
+===========================================*/
+
+/*
+    LRU stack distance histogram of a page access stream. Every page
+    holds a mark at the time slot of its last access in a Fenwick tree,
+    the reuse distance of an access is the number of marks at or after
+    the last access of its page. Slots are compacted when they run out
+    so the tree stays at 2 * n_pages whatever the stream length.
+*/
+typedef struct{
+    long long n_pages;              // Distinct pages the stream can reference
+    long long cap;                  // Time slots in the tree
+    long long top;                  // Next free time slot
+    long long live;                 // Marked slots, pages seen so far
+    int* tree;                      // Fenwick tree over time slots, 1-based
+    long long* slot_page;           // Page marked at a slot, -1 if none
+    long long* last;                // Slot of the last access of a page, -1 if never
+    unsigned long long* hist;       // hist[d] accesses at stack distance d
+    unsigned long long n_cold;      // First accesses
+    unsigned long long n_accesses;
+} Mrc;
+
+/*
+    SHARDS approximation of the curve. A page is sampled when its hash is
+    below threshold, at most budget pages are tracked by giving up the
+    one with the largest hash and lowering threshold to it. Sampled pages
+    get dense ids in an exact Mrc of budget pages, their distances and
+    counts are scaled by the inverse of the rate at the time of access.
+    Memory does not grow with the trace or the address space.
+*/
+typedef struct{
+    long long budget;               // Pages tracked at most
+    uint32_t threshold;             // Pages with hash < threshold are sampled
+    Mrc* stack;                     // Stack distances among sampled pages
+    long long* keys;                // Open addressed page -> id table, -1 if empty
+    long long* ids;
+    long long table_mask;
+    long long* heap_page;           // Max heap of tracked pages by hash
+    uint32_t* heap_hash;
+    long long n_tracked;
+    long long* free_ids;            // Ids of given up pages
+    long long n_free;
+    long long n_pages;              // Address space in pages
+    long long bin_width;            // Frames per histogram bucket past SHARDS_BINS / 2
+    double* hist;                   // Weighted accesses by scaled distance bucket
+    double n_cold;                  // Weighted first accesses
+    double n_weight;                // Weighted sampled accesses
+    unsigned long long n_accesses;  // Every access seen, sampled or not
+    unsigned long long n_sampled;
+} Shards;
+
+/*===========================================
+=            Function Prototypes            =
+===========================================*/
+
+Mrc* mrc_create(long long n_pages);
+void mrc_free(Mrc *m);
+long long mrc_access(Mrc *m, long long page);
+void mrc_forget(Mrc *m, long long page);
+void mrc_curve(Mrc *m, unsigned long long* misses);
+void mrc_print(Mrc *m, FILE *out, long long mark, int f_size);
+int mrc_write(Mrc *m, const char* path, int f_size);
+
+Shards* shards_create(long long n_pages, long long budget);
+void shards_free(Shards *sh);
+void shards_access(Shards *sh, long long page);
+void shards_print(Shards *sh, FILE *out, long long mark, int f_size, Mrc *exact);
+
+#endif
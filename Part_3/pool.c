@@ -0,0 +1,230 @@
+//
+//  pool.c
+//  Virtual Memory Part 3
+//
+//  Created by Muhammed Okumuş on 23.06.2020.
+//  Copyright 2020 Muhammed Okumus. All rights reserved.
+//
+
+#include "pool.h"
+#include <sched.h>
+
+static void deque_push(Deque *dq, Task *t);
+static Task* deque_pop(Deque *dq);
+static Task* deque_steal(Deque *dq);
+static void task_finish(Task *t, Worker *w);
+static void pool_queue(Worker *w, Task *t);
+static void pool_idle(Pool *p);
+static void *thread_pool_worker(void *arg);
+
+/*=============================================
+=            Pool                             =
+=============================================*/
+
+/**
+ *  Pool of n_workers workers, worker i accesses memory as ctxs[i].
+ *  Contexts of one process come from ctx_fork so they share the owner.
+ */
+Pool* pool_create(Context** ctxs, int n_workers){
+    Pool *p = calloc(1, sizeof(Pool));
+    if(p == NULL) _errExit("calloc @pool_create");
+    if(n_workers < 1 || n_workers > MAX_WORKERS) _errExit("Invalid # of workers @pool_create");
+
+    p->n_workers = n_workers;
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    for(int i = 0; i < n_workers; i++){
+        Worker *w = &p->workers[i];
+        w->pool = p;
+        w->id = i;
+        w->c = ctxs[i];
+        w->seed = i + 1;
+        w->dq.cap = DEQUE_INIT;
+        w->dq.tasks = malloc(sizeof(Task*) * w->dq.cap);
+        if(w->dq.tasks == NULL) _errExit("malloc @pool_create");
+        pthread_mutex_init(&w->dq.mutex, NULL);
+    }
+    return p;
+}
+
+void pool_destroy(Pool *p){
+    for(int i = 0; i < p->n_workers; i++){
+        free(p->workers[i].dq.tasks);
+        pthread_mutex_destroy(&p->workers[i].dq.mutex);
+    }
+    pthread_mutex_destroy(&p->mutex);
+    pthread_cond_destroy(&p->cond);
+    free(p);
+}
+
+/**
+ *  Runs root and everything it spawns to completion. The calling thread
+ *  is worker 0, the others get a thread each for the duration.
+ */
+void pool_run(Pool *p, Task *root){
+    pthread_t threads[MAX_WORKERS];
+
+    p->done = 0;
+    p->n_queued = p->n_idle = 0;
+    pool_queue(&p->workers[0], root);
+    for(int i = 1; i < p->n_workers; i++)
+        pthread_create(&threads[i], NULL, thread_pool_worker, &p->workers[i]);
+    thread_pool_worker(&p->workers[0]);
+    for(int i = 1; i < p->n_workers; i++)
+        pthread_join(threads[i], NULL);
+}
+
+Task* task_new(void (*run)(Task*, Worker*), void (*join)(Task*, Worker*), long long lo, long long hi){
+    Task *t = malloc(sizeof(Task));
+    if(t == NULL) _errExit("malloc @task_new");
+
+    t->run = run;
+    t->join = join;
+    t->parent = NULL;
+    t->pending = 1;
+    t->lo = lo;
+    t->hi = hi;
+    t->mid = -1;
+    return t;
+}
+
+// Makes t a child of parent and queues it on the deque of w
+void pool_spawn(Worker *w, Task *parent, Task *t){
+    t->parent = parent;
+    __atomic_add_fetch(&parent->pending, 1, __ATOMIC_RELAXED);
+    pool_queue(w, t);
+}
+
+// Queues t on the deque of w and wakes a parked worker to steal it
+static void pool_queue(Worker *w, Task *t){
+    Pool *p = w->pool;
+
+    deque_push(&w->dq, t);
+    __atomic_add_fetch(&p->n_queued, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&p->n_idle, __ATOMIC_SEQ_CST) > 0){
+        pthread_mutex_lock(&p->mutex);
+        pthread_cond_signal(&p->cond);
+        pthread_mutex_unlock(&p->mutex);
+    }
+}
+
+/*
+    Called when w found nothing to run. While tasks are queued somewhere
+    a later steal can find them, otherwise the worker sleeps until one is
+    queued or the pool is done, so idle time is not charged as CPU time.
+*/
+static void pool_idle(Pool *p){
+    if(__atomic_load_n(&p->n_queued, __ATOMIC_SEQ_CST) > 0){
+        sched_yield();
+        return;
+    }
+    pthread_mutex_lock(&p->mutex);
+    __atomic_add_fetch(&p->n_idle, 1, __ATOMIC_SEQ_CST);
+    while(!__atomic_load_n(&p->done, __ATOMIC_ACQUIRE) && __atomic_load_n(&p->n_queued, __ATOMIC_SEQ_CST) == 0)
+        pthread_cond_wait(&p->cond, &p->mutex);
+    __atomic_sub_fetch(&p->n_idle, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+/*
+    Worker loop, own tasks newest first and otherwise the oldest task of
+    a random victim, parks when there is nothing to take. Runs until the
+    root task is finished.
+*/
+static void *thread_pool_worker(void *arg){
+    Worker *w = arg;
+    Pool *p = w->pool;
+    Task *t;
+    struct timespec c0, c1;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+    while(!__atomic_load_n(&p->done, __ATOMIC_ACQUIRE)){
+        t = deque_pop(&w->dq);
+        if(t == NULL && p->n_workers > 1){
+            int v = rand_r(&w->seed) % (p->n_workers - 1);
+            if(v >= w->id) v++;     // Any worker but w
+            t = deque_steal(&p->workers[v].dq);
+            if(t != NULL) w->n_steals++;
+        }
+        if(t == NULL){
+            pool_idle(p);
+            continue;
+        }
+        __atomic_sub_fetch(&p->n_queued, 1, __ATOMIC_SEQ_CST);
+        w->n_tasks++;
+        t->run(t, w);
+        task_finish(t, w);
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+    w->cpu = (c1.tv_sec - c0.tv_sec) + (c1.tv_nsec - c0.tv_nsec) / 1e9;
+    return NULL;
+}
+
+/*
+    Drops the pending count of t, the last one out runs the join and
+    finishes the parent in turn. Finishing the root ends pool_run.
+*/
+static void task_finish(Task *t, Worker *w){
+    while(t != NULL && __atomic_sub_fetch(&t->pending, 1, __ATOMIC_ACQ_REL) == 0){
+        Task *parent = t->parent;
+
+        if(t->join != NULL)
+            t->join(t, w);
+        if(parent == NULL){   // Wake the parked workers to exit
+            pthread_mutex_lock(&w->pool->mutex);
+            __atomic_store_n(&w->pool->done, 1, __ATOMIC_RELEASE);
+            pthread_cond_broadcast(&w->pool->cond);
+            pthread_mutex_unlock(&w->pool->mutex);
+        }
+        free(t);
+        t = parent;
+    }
+}
+
+/*=============================================
+=            Deque                            =
+=============================================*/
+
+static void deque_push(Deque *dq, Task *t){
+    pthread_mutex_lock(&dq->mutex);
+    if(dq->bottom - dq->top == dq->cap){
+        Task** tasks = malloc(sizeof(Task*) * dq->cap * 2);
+        if(tasks == NULL) _errExit("malloc @deque_push");
+        for(long long i = dq->top; i < dq->bottom; i++)
+            tasks[i & (dq->cap * 2 - 1)] = dq->tasks[i & (dq->cap - 1)];
+        free(dq->tasks);
+        dq->tasks = tasks;
+        dq->cap *= 2;
+    }
+    dq->tasks[dq->bottom & (dq->cap - 1)] = t;
+    __atomic_store_n(&dq->bottom, dq->bottom + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&dq->mutex);
+}
+
+static Task* deque_pop(Deque *dq){
+    Task *t = NULL;
+
+    pthread_mutex_lock(&dq->mutex);
+    if(dq->bottom > dq->top){
+        __atomic_store_n(&dq->bottom, dq->bottom - 1, __ATOMIC_RELAXED);
+        t = dq->tasks[dq->bottom & (dq->cap - 1)];
+    }
+    pthread_mutex_unlock(&dq->mutex);
+    return t;
+}
+
+static Task* deque_steal(Deque *dq){
+    Task *t = NULL;
+
+    // Nothing to take, skip the lock. top and bottom are only changed under
+    // the mutex but stored atomically, so this racy peek is well defined.
+    if(__atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) <= __atomic_load_n(&dq->top, __ATOMIC_RELAXED))
+        return NULL;
+    pthread_mutex_lock(&dq->mutex);
+    if(dq->bottom > dq->top){
+        t = dq->tasks[dq->top & (dq->cap - 1)];
+        __atomic_store_n(&dq->top, dq->top + 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&dq->mutex);
+    return t;
+}
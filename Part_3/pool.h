@@ -0,0 +1,81 @@
+//
+//  pool.h
+//  Virtual Memory Part 3
+//
+//  Created by Muhammed Okumuş on 23.06.2020.
+//  Copyright 2020 Muhammed Okumus. All rights reserved.
+//
+
+#ifndef POOL_H
+#define POOL_H
+
+#include "vm.h"
+
+#define MAX_WORKERS 64      // Workers of one pool
+#define DEQUE_INIT 64       // Initial deque capacity, grows by doubling
+
+/*===========================================
+=            Work Stealing Pool             =
+===========================================*/
+
+typedef struct Task Task;
+typedef struct Worker Worker;
+typedef struct Pool Pool;
+
+/*
+    Unit of work of a pool. run may spawn children with pool_spawn, join
+    runs on whichever worker finishes the last of them, after run itself.
+*/
+struct Task{
+    void (*run)(Task *t, Worker *w);
+    void (*join)(Task *t, Worker *w);   // NULL if nothing to do after the children
+    Task *parent;
+    int pending;            // run and unfinished children
+    long long lo, hi;       // Range of the task
+    long long mid;          // Split point for join
+};
+
+/*
+    Task deque of a worker, the worker pushes and pops at the bottom,
+    thieves take the oldest(largest) tasks from the top. top and bottom
+    change under mutex only, with atomic stores for the lock free peek
+    of deque_steal.
+*/
+typedef struct{
+    Task** tasks;
+    long long top, bottom;
+    long long cap;          // Power of 2
+    pthread_mutex_t mutex;
+} Deque;
+
+struct Worker{
+    Pool *pool;
+    int id;
+    Context *c;             // Context the tasks of this worker access memory with
+    Deque dq;
+    unsigned int seed;      // Victim choice
+    unsigned long long n_tasks, n_steals;
+    double cpu;             // CPU time of the worker thread in seconds, parked time excluded
+};
+
+struct Pool{
+    Worker workers[MAX_WORKERS];
+    int n_workers;
+    int done;               // Root task finished
+    int n_queued;           // Tasks in the deques
+    int n_idle;             // Workers parked on cond
+    pthread_mutex_t mutex;  // Guards parking
+    pthread_cond_t cond;    // Signalled when a task is queued or the pool is done
+};
+
+/*===========================================
+=            Function Prototypes            =
+===========================================*/
+
+Pool* pool_create(Context** ctxs, int n_workers);
+void pool_destroy(Pool *p);
+void pool_run(Pool *p, Task *root);
+Task* task_new(void (*run)(Task*, Worker*), void (*join)(Task*, Worker*), long long lo, long long hi);
+void pool_spawn(Worker *w, Task *parent, Task *t);
+
+#endif
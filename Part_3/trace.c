@@ -0,0 +1,442 @@
+//
+//  trace.c
+//  Virtual Memory Part 3
+//
+//  Created by Muhammed Okumuş on 23.06.2020.
+//  Copyright 2020 Muhammed Okumus. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+#define _errExit(msg) do{ perror(msg); exit(EXIT_FAILURE); } while(0)
+
+/*=============================================
+=            Encoding                         =
+=============================================*/
+
+static inline unsigned char* put_varint(unsigned char* p, uint64_t v){
+    while(v >= 0x80){
+        *p++ = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char) v;
+    return p;
+}
+
+static inline const unsigned char* get_varint(const unsigned char* p, uint64_t* v){
+    uint64_t x = 0;
+    int shift = 0;
+
+    while(*p & 0x80){
+        x |= (uint64_t) (*p++ & 0x7f) << shift;
+        shift += 7;
+    }
+    *v = x | ((uint64_t) *p++ << shift);
+    return p;
+}
+
+static inline uint64_t zigzag(int64_t v){ return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63); }
+static inline int64_t unzigzag(uint64_t v){ return (int64_t) (v >> 1) ^ -(int64_t) (v & 1); }
+
+/*=============================================
+=            Trace Writer                     =
+=============================================*/
+
+static TraceBuf* trace_buf_get(Trace *t){
+    TraceBuf *b;
+
+    pthread_mutex_lock(&t->mutex);
+    b = t->free_bufs;
+    if(b != NULL)
+        t->free_bufs = b->next;
+    pthread_mutex_unlock(&t->mutex);
+
+    if(b == NULL){
+        b = malloc(sizeof(TraceBuf));
+        if(b == NULL) _errExit("malloc @trace_buf_get");
+        b->data = malloc(TRACE_CHUNK);
+        if(b->data == NULL) _errExit("malloc @trace_buf_get");
+    }
+    memset(&b->head, 0, sizeof(TraceChunk));
+    b->next = NULL;
+    return b;
+}
+
+// Queues the chunk of a thread for the writer and gives it an empty one
+static void trace_submit(Trace *t, int thread){
+    TraceBuf *b = t->bufs[thread];
+
+    t->bufs[thread] = trace_buf_get(t);
+    if(b->head.n_events == 0){
+        pthread_mutex_lock(&t->mutex);
+        b->next = t->free_bufs;
+        t->free_bufs = b;
+        pthread_mutex_unlock(&t->mutex);
+        return;
+    }
+
+    b->head.sync = TRACE_SYNC;
+    b->head.thread = thread;
+    pthread_mutex_lock(&t->mutex);
+    if(t->queue_tail != NULL) t->queue_tail->next = b;
+    else                      t->queue_head = b;
+    t->queue_tail = b;
+    pthread_cond_signal(&t->cond_queue);
+    pthread_mutex_unlock(&t->mutex);
+}
+
+/*
+    Writer thread, appends queued chunks to the file and indexes them.
+    Drains the queue before leaving on exit_requested.
+*/
+static void *thread_trace_writer(void *arg){
+    Trace *t = arg;
+    TraceBuf *b;
+
+    while(1){
+        pthread_mutex_lock(&t->mutex);
+        while(t->queue_head == NULL && !t->exit_requested)
+            pthread_cond_wait(&t->cond_queue, &t->mutex);
+        b = t->queue_head;
+        if(b == NULL){
+            pthread_mutex_unlock(&t->mutex);
+            break;
+        }
+        t->queue_head = b->next;
+        if(t->queue_head == NULL)
+            t->queue_tail = NULL;
+        pthread_mutex_unlock(&t->mutex);
+
+        if(t->n_chunks % 256 == 0){
+            t->index = realloc(t->index, sizeof(TraceIndex) * (t->n_chunks + 256));
+            if(t->index == NULL) _errExit("realloc @thread_trace_writer");
+        }
+        t->index[t->n_chunks++] = (TraceIndex){b->head.thread, b->head.n_events,
+                                               b->head.first_seq, b->head.last_seq, t->bytes};
+
+        if(fwrite(&b->head, sizeof(TraceChunk), 1, t->fd) != 1 ||
+           fwrite(b->data, 1, b->head.payload_len, t->fd) != b->head.payload_len)
+            _errExit("fwrite @thread_trace_writer");
+        t->bytes += sizeof(TraceChunk) + b->head.payload_len;
+
+        pthread_mutex_lock(&t->mutex);
+        b->next = t->free_bufs;
+        t->free_bufs = b;
+        pthread_mutex_unlock(&t->mutex);
+    }
+    pthread_exit(0);
+}
+
+/**
+ *  Creates the trace file at path and starts its writer thread. f_size
+ *  and n_words of the traced machine are kept in the header so a replay
+ *  can check it runs on the same geometry.
+ */
+Trace* trace_create(const char* path, uint64_t f_size, uint64_t n_words){
+    Trace *t = calloc(1, sizeof(Trace));
+    TraceHeader h = {TRACE_MAGIC, 1, f_size, n_words};
+
+    if(t == NULL) _errExit("calloc @trace_create");
+    t->fd = fopen(path, "wb");
+    if(t->fd == NULL) _errExit("fopen @trace_create");
+    if(fwrite(&h, sizeof(h), 1, t->fd) != 1) _errExit("fwrite @trace_create");
+    t->bytes = sizeof(h);
+
+    pthread_mutex_init(&t->mutex, NULL);
+    pthread_cond_init(&t->cond_queue, NULL);
+    pthread_create(&t->writer, NULL, thread_trace_writer, t);
+    return t;
+}
+
+// Registers thread(a context index) with its name, threads may come in any order
+void trace_thread(Trace *t, int thread, const char* name, int shared){
+    if(thread >= t->n_threads){
+        t->bufs = realloc(t->bufs, sizeof(TraceBuf*) * (thread + 1));
+        t->threads = realloc(t->threads, sizeof(TraceThread) * (thread + 1));
+        if(t->bufs == NULL || t->threads == NULL) _errExit("realloc @trace_thread");
+        for(int i = t->n_threads; i <= thread; i++){
+            t->bufs[i] = trace_buf_get(t);
+            memset(&t->threads[i], 0, sizeof(TraceThread));
+        }
+        t->n_threads = thread + 1;
+    }
+    snprintf(t->threads[thread].name, TRACE_NAME, "%s", name);
+    t->threads[thread].shared = shared;
+}
+
+/**
+ *  Appends an event of thread and gives it the next event number. The
+ *  caller serializes calls(mutex_access), so numbers follow the order
+ *  the machine saw the accesses in.
+ */
+void trace_event(Trace *t, int thread, int op, uint64_t index, uint64_t a, uint64_t b){
+    TraceBuf *tb = t->bufs[thread];
+    uint64_t seq = t->n_events++;
+    unsigned char* p = tb->data + tb->head.payload_len;
+
+    if(tb->head.n_events == 0){
+        tb->head.first_seq = tb->prev_seq = seq;
+        tb->prev_index = 0;
+    }
+
+    p = put_varint(p, seq - tb->prev_seq);
+    *p++ = (unsigned char) op;
+    p = put_varint(p, zigzag((int64_t) (index - tb->prev_index)));
+    if(op == T_GET_RANGE || op == T_SET_RANGE || op == T_UNPIN)
+        p = put_varint(p, a);
+    if(op == T_UNPIN)
+        p = put_varint(p, b);
+
+    tb->prev_seq = seq;
+    tb->prev_index = index;
+    tb->head.last_seq = seq;
+    tb->head.n_events++;
+    tb->head.payload_len = p - tb->data;
+
+    if(tb->head.payload_len > TRACE_CHUNK - TRACE_EVENT_MAX)
+        trace_submit(t, thread);
+}
+
+/**
+ *  Flushes every thread's chunk, waits for the writer and finishes the
+ *  file with the thread table, chunk index and trailer. Returns the size
+ *  of the file.
+ */
+uint64_t trace_close(Trace *t){
+    uint64_t bytes;
+    TraceTrailer tr = {0};
+    TraceBuf *b;
+
+    for(int i = 0; i < t->n_threads; i++)
+        trace_submit(t, i);
+
+    pthread_mutex_lock(&t->mutex);
+    t->exit_requested = 1;
+    pthread_cond_signal(&t->cond_queue);
+    pthread_mutex_unlock(&t->mutex);
+    pthread_join(t->writer, NULL);
+
+    tr.index_offset = t->bytes;
+    tr.n_events = t->n_events;
+    tr.n_threads = t->n_threads;
+    tr.n_chunks = t->n_chunks;
+    tr.magic = TRACE_MAGIC;
+    if(fwrite(t->threads, sizeof(TraceThread), t->n_threads, t->fd) != (size_t) t->n_threads ||
+       fwrite(t->index, sizeof(TraceIndex), t->n_chunks, t->fd) != t->n_chunks ||
+       fwrite(&tr, sizeof(tr), 1, t->fd) != 1)
+        _errExit("fwrite @trace_close");
+    t->bytes += sizeof(TraceThread) * t->n_threads + sizeof(TraceIndex) * t->n_chunks + sizeof(tr);
+    fclose(t->fd);
+    bytes = t->bytes;
+
+    for(int i = 0; i < t->n_threads; i++){
+        t->bufs[i]->next = t->free_bufs;
+        t->free_bufs = t->bufs[i];
+    }
+    while((b = t->free_bufs) != NULL){
+        t->free_bufs = b->next;
+        free(b->data);
+        free(b);
+    }
+    pthread_mutex_destroy(&t->mutex);
+    pthread_cond_destroy(&t->cond_queue);
+    free(t->bufs);
+    free(t->threads);
+    free(t->index);
+    free(t);
+    return bytes;
+}
+
+/*=============================================
+=            Trace Reader                     =
+=============================================*/
+
+/**
+ *  Maps the trace at path for reading, NULL if it is not a complete
+ *  trace file. Every thread starts at event 0.
+ */
+TraceReader* trace_open(const char* path){
+    TraceReader *r;
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if(fd == -1)
+        return NULL;
+    if(fstat(fd, &st) == -1 || st.st_size < (off_t) (sizeof(TraceHeader) + sizeof(TraceTrailer))){
+        close(fd);
+        return NULL;
+    }
+
+    r = calloc(1, sizeof(TraceReader));
+    if(r == NULL) _errExit("calloc @trace_open");
+    r->len = st.st_size;
+    r->map = mmap(NULL, r->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(r->map == MAP_FAILED) _errExit("mmap @trace_open");
+    madvise((void*) r->map, r->len, MADV_SEQUENTIAL);
+
+    r->header = (const TraceHeader*) r->map;
+    r->trailer = (const TraceTrailer*) (r->map + r->len - sizeof(TraceTrailer));
+    if(r->header->magic != TRACE_MAGIC || r->trailer->magic != TRACE_MAGIC ||
+       r->trailer->index_offset + sizeof(TraceThread) * r->trailer->n_threads
+       + sizeof(TraceIndex) * r->trailer->n_chunks + sizeof(TraceTrailer) != r->len){
+        r->threads = NULL;
+        trace_reader_close(r);
+        return NULL;
+    }
+    r->threads = (const TraceThread*) (r->map + r->trailer->index_offset);
+    r->index = (const TraceIndex*) (r->threads + r->trailer->n_threads);
+
+    // Chunks of a thread are written in seq order
+    r->chunks = calloc(r->trailer->n_threads, sizeof(uint32_t*));
+    r->n_chunks = calloc(r->trailer->n_threads, sizeof(uint32_t));
+    r->cursors = calloc(r->trailer->n_threads, sizeof(TraceCursor));
+    if(r->chunks == NULL || r->n_chunks == NULL || r->cursors == NULL) _errExit("calloc @trace_open");
+    for(uint32_t i = 0; i < r->trailer->n_chunks; i++)
+        r->n_chunks[r->index[i].thread]++;
+    for(uint32_t th = 0; th < r->trailer->n_threads; th++){
+        r->chunks[th] = malloc(sizeof(uint32_t) * (r->n_chunks[th] + 1));
+        if(r->chunks[th] == NULL) _errExit("malloc @trace_open");
+        r->n_chunks[th] = 0;
+    }
+    for(uint32_t i = 0; i < r->trailer->n_chunks; i++)
+        r->chunks[r->index[i].thread][r->n_chunks[r->index[i].thread]++] = i;
+
+    trace_seek(r, 0);
+    return r;
+}
+
+void trace_reader_close(TraceReader *r){
+    if(r->threads != NULL){
+        for(uint32_t th = 0; th < r->trailer->n_threads; th++){
+            free(r->chunks[th]);
+            free(r->cursors[th].events);
+        }
+    }
+    free(r->chunks);
+    free(r->n_chunks);
+    free(r->cursors);
+    munmap((void*) r->map, r->len);
+    free(r);
+}
+
+int trace_n_threads(TraceReader *r){ return r->trailer->n_threads; }
+uint64_t trace_n_events(TraceReader *r){ return r->trailer->n_events; }
+
+// Decodes the next chunk of thread into its cursor, 0 if it has no more
+static int trace_decode(TraceReader *r, int thread){
+    TraceCursor *cur = &r->cursors[thread];
+    const TraceChunk *h;
+    const unsigned char* p;
+    uint64_t seq, index = 0, v;
+
+    if(cur->chunk >= r->n_chunks[thread])
+        return 0;
+    h = (const TraceChunk*) (r->map + r->index[r->chunks[thread][cur->chunk++]].offset);
+    if(h->sync != TRACE_SYNC) _errExit("Error: Bad chunk @trace_decode");
+
+    cur->events = realloc(cur->events, sizeof(TraceEvent) * h->n_events);
+    if(cur->events == NULL) _errExit("realloc @trace_decode");
+    p = (const unsigned char*) (h + 1);
+    seq = h->first_seq;
+    for(uint32_t i = 0; i < h->n_events; i++){
+        TraceEvent *e = &cur->events[i];
+
+        p = get_varint(p, &v);
+        seq += v;
+        e->seq = seq;
+        e->thread = thread;
+        e->op = *p++;
+        p = get_varint(p, &v);
+        index += unzigzag(v);
+        e->index = index;
+        e->a = e->b = 0;
+        if(e->op == T_GET_RANGE || e->op == T_SET_RANGE || e->op == T_UNPIN)
+            p = get_varint(p, &e->a);
+        if(e->op == T_UNPIN)
+            p = get_varint(p, &e->b);
+    }
+    cur->n = h->n_events;
+    cur->pos = 0;
+    return 1;
+}
+
+/**
+ *  Positions every thread at the first of its events numbered seq or
+ *  later. The chunk is found by binary search on the index, only that
+ *  chunk is decoded.
+ */
+void trace_seek(TraceReader *r, uint64_t seq){
+    for(uint32_t th = 0; th < r->trailer->n_threads; th++){
+        TraceCursor *cur = &r->cursors[th];
+        uint32_t lo = 0, hi = r->n_chunks[th];
+
+        // First chunk ending at or after seq
+        while(lo < hi){
+            uint32_t mid = (lo + hi) / 2;
+            if(r->index[r->chunks[th][mid]].last_seq < seq) lo = mid + 1;
+            else                                            hi = mid;
+        }
+        cur->chunk = lo;
+        cur->n = cur->pos = 0;
+        if(trace_decode(r, th)){
+            while(cur->pos < cur->n && cur->events[cur->pos].seq < seq)
+                cur->pos++;
+        }
+    }
+    r->last = -1;
+}
+
+/**
+ *  Next event in event number order over every thread, 0 at the end.
+ */
+int trace_next(TraceReader *r, TraceEvent *e){
+    int best = r->last;
+
+    // Threads run for a while between switches, while the last thread
+    // holds the next event number there is nothing to merge
+    if(best != -1){
+        TraceCursor *cur = &r->cursors[best];
+        if(cur->pos < cur->n && cur->events[cur->pos].seq == r->next_seq){
+            *e = cur->events[cur->pos++];
+            r->next_seq++;
+            return 1;
+        }
+    }
+
+    best = -1;
+
+    for(uint32_t th = 0; th < r->trailer->n_threads; th++){
+        TraceCursor *cur = &r->cursors[th];
+
+        if(cur->pos == cur->n && !trace_decode(r, th))
+            continue;
+        if(best == -1 || cur->events[cur->pos].seq < r->cursors[best].events[r->cursors[best].pos].seq)
+            best = th;
+    }
+    if(best == -1)
+        return 0;
+    *e = r->cursors[best].events[r->cursors[best].pos++];
+    r->last = best;
+    r->next_seq = e->seq + 1;
+    return 1;
+}
+
+/**
+ *  Next event of thread alone, 0 at its end. Calls for different
+ *  threads touch different cursors and may run at the same time.
+ */
+int trace_next_thread(TraceReader *r, int thread, TraceEvent *e){
+    TraceCursor *cur = &r->cursors[thread];
+
+    if(cur->pos == cur->n && !trace_decode(r, thread))
+        return 0;
+    *e = cur->events[cur->pos++];
+    return 1;
+}
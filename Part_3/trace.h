@@ -0,0 +1,181 @@
+//
+//  trace.h
+//  Virtual Memory Part 3
+//
+//  Created by Muhammed Okumuş on 23.06.2020.
+//  Copyright 2020 Muhammed Okumus. All rights reserved.
+//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define TRACE_MAGIC 0x31524d56u     // "VMR1"
+#define TRACE_SYNC  0xf00dcafeu     // Starts every chunk
+#define TRACE_CHUNK (64 * 1024)     // Encoded bytes per chunk at most
+#define TRACE_EVENT_MAX 40          // Encoded bytes per event at most
+#define TRACE_NAME 32
+
+/*
+    Access operations as recorded, one per call that takes mutex_access.
+    Range operations are recorded per locked piece so a piece never
+    crosses a page.
+*/
+enum{
+    T_GET,              // index
+    T_SET,              // index
+    T_GET_RANGE,        // index, a = len
+    T_SET_RANGE,        // index, a = len
+    T_PIN_READ,         // index
+    T_PIN_WRITE,        // index
+    T_UNPIN,            // index = span start, a = reads, b = writes
+    T_OPS
+};
+
+/*
+    Trace file layout, little endian:
+        TraceHeader
+        chunks: TraceChunk + payload, events of one thread in seq order
+        TraceThread[n_threads]
+        TraceIndex[n_chunks] in file order
+        TraceTrailer
+    An event in a payload is varint(seq - previous seq), op byte,
+    varint(zigzag(index - previous index)) and a/b as varints where the
+    op has them. Previous values start at first_seq and 0 in every chunk
+    so any chunk decodes on its own, the index finds the chunk holding
+    an event number and TRACE_SYNC lets a damaged file be rescanned.
+*/
+typedef struct{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t f_size;
+    uint64_t n_words;
+} TraceHeader;
+
+typedef struct{
+    uint32_t sync;
+    uint32_t thread;
+    uint32_t n_events;
+    uint32_t payload_len;
+    uint64_t first_seq;
+    uint64_t last_seq;
+} TraceChunk;
+
+typedef struct{
+    char name[TRACE_NAME];
+    uint32_t shared;
+    uint32_t reserved;
+} TraceThread;
+
+typedef struct{
+    uint32_t thread;
+    uint32_t n_events;
+    uint64_t first_seq;
+    uint64_t last_seq;
+    uint64_t offset;            // Of the TraceChunk
+} TraceIndex;
+
+typedef struct{
+    uint64_t index_offset;      // Of the first TraceThread
+    uint64_t n_events;
+    uint32_t n_threads;
+    uint32_t n_chunks;
+    uint32_t magic;
+    uint32_t reserved;
+} TraceTrailer;
+
+/*===========================================
+=            Trace Writer                   =
+===========================================*/
+
+// Events of one thread waiting for their chunk to fill
+typedef struct TraceBuf{
+    TraceChunk head;
+    unsigned char* data;
+    uint64_t prev_seq, prev_index;
+    struct TraceBuf* next;      // In the flush queue or free list
+} TraceBuf;
+
+/*
+    Recorder of one machine. trace_event is called with the machine's
+    mutex_access held, full chunks are handed to a writer thread so the
+    access path never waits on the file.
+*/
+typedef struct{
+    FILE* fd;
+    uint64_t n_events;          // Next event number
+    TraceBuf** bufs;            // Filling chunk of each thread
+    TraceThread* threads;
+    int n_threads;
+
+    pthread_t writer;
+    pthread_mutex_t mutex;      // Guards the queue and free list
+    pthread_cond_t cond_queue;
+    TraceBuf* queue_head;       // Full chunks in submit order
+    TraceBuf* queue_tail;
+    TraceBuf* free_bufs;        // Written chunks ready for reuse
+    int exit_requested;
+
+    TraceIndex* index;          // Written chunks, owned by the writer thread
+    uint32_t n_chunks;
+    uint64_t bytes;
+} Trace;
+
+/*===========================================
+=            Trace Reader                   =
+===========================================*/
+
+typedef struct{
+    int thread;
+    int op;
+    uint64_t seq;
+    uint64_t index;
+    uint64_t a, b;
+} TraceEvent;
+
+// Decoded chunk of one thread and the position in it
+typedef struct{
+    TraceEvent* events;
+    uint32_t n, pos;
+    uint32_t chunk;             // Next chunk of the thread to decode
+} TraceCursor;
+
+/*
+    Trace file mapped for reading. Chunks of each thread are listed in
+    seq order, events are merged back into seq order by trace_next.
+*/
+typedef struct{
+    const unsigned char* map;
+    size_t len;
+    const TraceHeader* header;
+    const TraceTrailer* trailer;
+    const TraceThread* threads;
+    const TraceIndex* index;
+    uint32_t** chunks;          // Index entries of each thread
+    uint32_t* n_chunks;
+    TraceCursor* cursors;
+    int last;                   // Thread of the last event of trace_next, -1 if none
+    uint64_t next_seq;          // Event number after it
+} TraceReader;
+
+/*===========================================
+=            Function Prototypes            =
+===========================================*/
+
+Trace* trace_create(const char* path, uint64_t f_size, uint64_t n_words);
+void trace_thread(Trace *t, int thread, const char* name, int shared);
+void trace_event(Trace *t, int thread, int op, uint64_t index, uint64_t a, uint64_t b);
+uint64_t trace_close(Trace *t);
+
+TraceReader* trace_open(const char* path);
+void trace_reader_close(TraceReader *r);
+int trace_n_threads(TraceReader *r);
+uint64_t trace_n_events(TraceReader *r);
+void trace_seek(TraceReader *r, uint64_t seq);
+int trace_next(TraceReader *r, TraceEvent *e);
+int trace_next_thread(TraceReader *r, int thread, TraceEvent *e);
+
+#endif
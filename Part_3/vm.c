@@ -0,0 +1,1806 @@
+//
+//  vm.c
+//  Virtual Memory Part 3
+//
+//  Created by Muhammed Okumuş on 23.06.2020.
+//  Copyright 2020 Muhammed Okumus. All rights reserved.
+//
+
+#include "vm.h"
+
+/*========================================
+=            Global Constants            =
+========================================*/
+
+const char* PR_TYPES[] = {"NRU", "FIFO", "SC", "LRU"};
+const char* AP_TYPES[] = {"global","local"};
+const int PR_N =  sizeof(PR_TYPES) / sizeof(PR_TYPES[0]);
+const int AP_N =  sizeof(AP_TYPES) / sizeof(AP_TYPES[0]);
+
+static Context* ctx_add(VirtualMemory *vm, const char* name, int shared, int id);
+static void frame_pin(VirtualMemory *vm, long long j);
+static void frame_unpin(VirtualMemory *vm, long long j);
+static void cursor_release(Cursor *cur);
+static void ctx_charge_run(Context *c);
+static int ctx_release_cursors(Context *c);
+
+/*
+    Machine without disk and physical memory, page table and frame table
+    are set up for the given geometry and the replacement policy is
+    resolved from pr and ap
+*/
+static VirtualMemory* vm_alloc(int frame_size, int num_virtual, int num_physical, int pr, int ap){
+    VirtualMemory *vm = calloc(1, sizeof(VirtualMemory));
+    if(vm == NULL) _errExit("calloc @vm_create");
+
+    /*=======================================================
+    =            Initilize Calculated Properties            =
+    =======================================================*/
+    vm->n_words = 1ULL << (num_virtual + frame_size);
+    vm->n_pframes = 1LL << num_physical;
+    vm->n_vframes = 1LL << num_virtual;
+    vm->n_entries = vm->n_vframes;
+    vm->f_size = 1 << frame_size;
+    vm->m_size = vm->n_pframes * vm->f_size;
+    vm->num_virtual = num_virtual;
+
+    vm->pr = pr;
+    vm->ap = ap;
+    policy_resolve(vm);
+
+    vm->n_owners = 1;           // Owner 0 is shared
+    vm->owner_frames = calloc(1, sizeof(long long*));
+    vm->n_owner_frames = calloc(1, sizeof(long long));
+    if(vm->owner_frames == NULL || vm->n_owner_frames == NULL) _errExit("calloc @vm_create");
+    vm->r_epoch = 1;
+    vm->arena_backing = "none";
+    pthread_mutex_init(&vm->mutex_access, NULL);
+    pthread_cond_init(&vm->cond_unpin, NULL);
+
+    pt_init(vm);
+    frames_init(vm);
+    if(vm->policy->init != NULL)
+        vm->policy->init(vm);
+
+    // Every frame free, bits past n_pframes stay clear
+    vm->bitmap_words = (vm->n_pframes + 63) / 64;
+    vm->bitmap = malloc(sizeof(unsigned long long) * vm->bitmap_words);
+    if(vm->bitmap == NULL) _errExit("malloc @vm_create");
+    for(long long k = 0; k < vm->bitmap_words; k++)
+        vm->bitmap[k] = ~0ULL;
+    if(vm->n_pframes % 64)
+        vm->bitmap[vm->bitmap_words - 1] = (1ULL << (vm->n_pframes % 64)) - 1;
+    vm->free_hint = 0;
+    vm->sp_block_hint = 0;
+
+    return vm;
+}
+
+/**
+ *  Creates a simulated machine for one test. The disk file is created
+ *  and filled with random integers from seed, physical memory, page
+ *  table and frame table are set up for the given geometry and the
+ *  replacement policy is resolved from pr and ap.
+ */
+VirtualMemory* vm_create(const char* disk_file, int frame_size, int num_virtual, int num_physical,
+                         int pr, int ap, unsigned int seed){
+    VirtualMemory *vm = vm_alloc(frame_size, num_virtual, num_physical, pr, ap);
+
+    // Fill VM file with random integers
+    snprintf(vm->disk_file, MAX_PATH, "%s", disk_file);
+    vm->fd = fopen(vm->disk_file, "w+");
+    if (vm->fd == NULL) _errExit("Error opening file @vm_create");
+    initilize_vm(vm, seed);
+
+    // Allocate physical memory for simulation
+    vm->memory = arena_alloc(vm, sizeof(int) * vm->m_size);
+
+    return vm;
+}
+
+/**
+ *  Attaches a shadow machine running policy pr/ap to vm. A shadow has
+ *  the geometry and contexts of vm but no disk or memory, every page
+ *  reference of vm is replayed on it under vm's mutex_access so it
+ *  keeps its own resident set and counts misses, replacements, DPR and
+ *  DPW at metadata cost. Shadows do not see pins.
+ */
+VirtualMemory* vm_add_shadow(VirtualMemory *vm, int pr, int ap){
+    VirtualMemory *sh = vm_alloc(__builtin_ctz(vm->f_size), vm->num_virtual,
+                                 __builtin_ctzll(vm->n_pframes), pr, ap);
+
+    sh->primary = vm;
+    for(int i = 0; i < vm->n_contexts; i++)
+        ctx_add(sh, vm->contexts[i]->stats.name, vm->contexts[i]->shared, vm->contexts[i]->id);
+
+    vm->shadows = realloc(vm->shadows, sizeof(VirtualMemory*) * (vm->n_shadows + 1));
+    if(vm->shadows == NULL) _errExit("realloc @vm_add_shadow");
+    vm->shadows[vm->n_shadows++] = sh;
+    return sh;
+}
+
+/**
+ *  Starts recording every access of vm to a trace file at path, see
+ *  trace.h. Contexts created before and after are both recorded.
+ */
+void vm_trace_start(VirtualMemory *vm, const char* path){
+    vm->trace = trace_create(path, vm->f_size, vm->n_words);
+    for(int i = 0; i < vm->n_contexts; i++)
+        trace_thread(vm->trace, i, vm->contexts[i]->stats.name, vm->contexts[i]->shared);
+}
+
+// Finishes the trace file, returns its size. No access may be in flight.
+unsigned long long vm_trace_stop(VirtualMemory *vm){
+    unsigned long long bytes = trace_close(vm->trace);
+    vm->trace = NULL;
+    return bytes;
+}
+
+// Frees everything held by vm and its shadows, the disk file is left in place
+void vm_destroy(VirtualMemory *vm){
+    for(int i = 0; i < vm->n_shadows; i++)
+        vm_destroy(vm->shadows[i]);
+    free(vm->shadows);
+    arena_free(vm);
+    free(vm->bitmap);
+    pt_free(vm);
+    frames_free(vm);
+    ctx_free_all(vm);
+    free(vm->owner_frames);
+    free(vm->n_owner_frames);
+    mrc_free(vm->mrc);
+    shards_free(vm->shards);
+    if(vm->trace != NULL)
+        vm_trace_stop(vm);
+    if(vm->fd != NULL)
+        fclose(vm->fd);
+    pthread_mutex_destroy(&vm->mutex_access);
+    pthread_cond_destroy(&vm->cond_unpin);
+    free(vm);
+}
+
+/**
+ *  Initlizes disk file that represent virtual memory.
+ *  File is pointed by vm->fd, it must be open before calling this
+ *  function. Integers come from rand_r(seed) so every machine gets the
+ *  same data no matter which thread builds it.
+ */
+void initilize_vm(VirtualMemory *vm, unsigned int seed){
+    debug("Initilizing virtual memory with random integers...\n");
+    clock_t t = clock();
+    // Write to file
+    // Written a frame at a time
+    int* buf = malloc(sizeof(int) * vm->f_size);
+    if(buf == NULL) _errExit("malloc @initilize_vm");
+    fseeko(vm->fd, 0, SEEK_SET);
+    for(unsigned long long i = 0; i < vm->n_words; i += vm->f_size){
+        for(int n = 0; n < vm->f_size; n++)
+            buf[n] = (int) rand_r(&seed);
+        fwrite(buf, sizeof(int), vm->f_size, vm->fd); if(errno < 0) _errExit("fwrite @initilize_vm: 1");
+    }
+    free(buf);
+
+    t = clock() - t;
+    double time_taken = ((double)t)/CLOCKS_PER_SEC; // calculate the elapsed time
+    debug("Virtual memory initilized in %f seconds.\n", time_taken);
+}
+
+/*=============================================
+=            Access Contexts                  =
+=============================================*/
+
+/**
+ *  Creates the access context of a simulated process and registers it.
+ *  Each context gets the next owner ID for local allocation, shared
+ *  contexts always use owner 0(global allocation). Contexts live until
+ *  ctx_free_all, any number of them can be created.
+ */
+Context* ctx_create(VirtualMemory *vm, const char* name, int shared){
+    return ctx_add(vm, name, shared, shared ? 0 : -1);
+}
+
+/**
+ *  Context for another thread of the process of parent, it has its own
+ *  stats and translation caches but the owner ID of parent so frames
+ *  are allocated to the process as a whole.
+ */
+Context* ctx_fork(Context *parent, const char* name){
+    return ctx_add(parent->vm, name, parent->shared, parent->id);
+}
+
+// Registers a context with owner ID id, a new owner if id is -1
+static Context* ctx_add(VirtualMemory *vm, const char* name, int shared, int id){
+    Context *c = aligned_alloc(CACHE_LINE, sizeof(Context));  // Size is a multiple of CACHE_LINE
+    int first = vm->n_owners;   // First owner list to set up
+    if(c == NULL) _errExit("aligned_alloc @ctx_create");
+
+    memset(c, 0, sizeof(Context));
+    c->vm = vm;
+    c->run_frame = -1;
+    snprintf(c->stats.name, NAME, "%s", name);
+    c->shared = shared;
+    c->id = (id < 0) ? vm->n_owners : id;
+    if(c->id >= vm->n_owners)
+        vm->n_owners = c->id + 1;
+
+    c->index = vm->n_contexts;
+
+    vm->contexts = realloc(vm->contexts, sizeof(Context*) * (vm->n_contexts + 1));
+    vm->owner_frames = realloc(vm->owner_frames, sizeof(long long*) * vm->n_owners);
+    vm->n_owner_frames = realloc(vm->n_owner_frames, sizeof(long long) * vm->n_owners);
+    if(vm->contexts == NULL || vm->owner_frames == NULL || vm->n_owner_frames == NULL) _errExit("realloc @ctx_create");
+    vm->contexts[vm->n_contexts++] = c;
+
+    for(int o = first; o < vm->n_owners; o++){
+        vm->owner_frames[o] = NULL;
+        vm->n_owner_frames[o] = 0;
+        if(vm->all_frames != NULL){ // Frame table already built
+            vm->owner_frames[o] = malloc(sizeof(long long) * vm->n_pframes);
+            if(vm->owner_frames[o] == NULL) _errExit("malloc @ctx_create");
+        }
+    }
+
+    ctx_reset(c);
+    if(vm->trace != NULL)
+        trace_thread(vm->trace, c->index, name, shared);
+    for(int i = 0; i < vm->n_shadows; i++)
+        ctx_add(vm->shadows[i], name, shared, c->id);
+    return c;
+}
+
+/*
+    Clears stats and translation caches of c and picks its owner ID
+    for the current allocation policy
+*/
+void ctx_reset(Context *c){
+    VirtualMemory *vm = c->vm;
+    char name[NAME];
+
+    memcpy(name, c->stats.name, NAME);
+    memset(&c->stats, 0, sizeof(Stats));
+    memcpy(c->stats.name, name, NAME);
+
+    c->owner = (!c->shared && vm->ap == 1) ? c->id : 0;
+    c->stats.owner = c->owner;
+    memset(c->tlb, 0, sizeof(c->tlb));
+    memset(c->stlb, 0, sizeof(c->stlb));
+}
+
+/*
+    Stats of a context are guarded by a sequence lock. Writers already hold
+    mutex_access, they make stats_seq odd for the update and store the
+    counters atomically so readers never need the mutex.
+*/
+#define STATS_BEGIN(c)  do{ __atomic_store_n(&(c)->stats_seq, (c)->stats_seq + 1, __ATOMIC_RELAXED); \
+                            __atomic_thread_fence(__ATOMIC_RELEASE); }while(0)
+#define STATS_END(c)    __atomic_store_n(&(c)->stats_seq, (c)->stats_seq + 1, __ATOMIC_RELEASE)
+#define STATS_ADD(c, f, n)      __atomic_store_n(&(c)->stats.f, (c)->stats.f + (n), __ATOMIC_RELAXED)
+#define STATS_CHARGE(c, f, n)   do{ STATS_BEGIN(c); STATS_ADD(c, f, n); STATS_END(c); }while(0)
+
+/*
+    Copy of the stats of c, consistent while threads are running. Lock
+    free, retries if a writer got in between.
+*/
+Stats ctx_snapshot(Context *c){
+    Stats s;
+    unsigned int seq;
+
+    memcpy(s.name, c->stats.name, NAME);
+    s.owner = c->stats.owner;
+    do{
+        seq = __atomic_load_n(&c->stats_seq, __ATOMIC_ACQUIRE);
+        if(seq & 1)     // Update in progress
+            continue;
+        s.n_reads = __atomic_load_n(&c->stats.n_reads, __ATOMIC_RELAXED);
+        s.n_writes = __atomic_load_n(&c->stats.n_writes, __ATOMIC_RELAXED);
+        s.n_misses = __atomic_load_n(&c->stats.n_misses, __ATOMIC_RELAXED);
+        s.n_replacements = __atomic_load_n(&c->stats.n_replacements, __ATOMIC_RELAXED);
+        s.n_dpw = __atomic_load_n(&c->stats.n_dpw, __ATOMIC_RELAXED);
+        s.n_dpr = __atomic_load_n(&c->stats.n_dpr, __ATOMIC_RELAXED);
+        s.n_pins = __atomic_load_n(&c->stats.n_pins, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    }while((seq & 1) || seq != __atomic_load_n(&c->stats_seq, __ATOMIC_RELAXED));
+    return s;
+}
+
+/*
+    Frames c can expect to keep resident, an equal share of the physical
+    memory between the private contexts. Workloads size their buffers
+    with it. At least one frame even if there are more contexts than frames.
+*/
+long long ctx_frames(Context *c){
+    int n = c->vm->n_owners - 1;    // Owner 0 is shared
+    long long f = c->vm->n_pframes / (n > 0 ? n : 1);
+
+    return (f > 0) ? f : 1;
+}
+
+/*
+    Stats of every context merged, lock free. Each context is a consistent
+    snapshot, they are not taken at the same instant.
+*/
+Stats stats_total(VirtualMemory *vm){
+    Stats t, s;
+
+    memset(&t, 0, sizeof(Stats));
+    snprintf(t.name, NAME, "%s", "Total");
+    for(int i = 0; i < vm->n_contexts; i++){
+        s = ctx_snapshot(vm->contexts[i]);
+        stats_add(&t, &s);
+    }
+    return t;
+}
+
+// Adds the counters of s to t
+void stats_add(Stats *t, const Stats *s){
+    t->n_reads += s->n_reads;
+    t->n_writes += s->n_writes;
+    t->n_misses += s->n_misses;
+    t->n_replacements += s->n_replacements;
+    t->n_dpw += s->n_dpw;
+    t->n_dpr += s->n_dpr;
+    t->n_pins += s->n_pins;
+}
+
+void ctx_free_all(VirtualMemory *vm){
+    for(int i = 0; i < vm->n_contexts; i++)
+        free(vm->contexts[i]);
+    free(vm->contexts);
+    vm->contexts = NULL;
+    vm->n_contexts = 0;
+}
+
+/*=============================================
+=            Physical Memory Arena            =
+=============================================*/
+
+/**
+ *  Maps bytes of zeroed memory for the simulated RAM. Explicit huge
+ *  pages are tried first, then a HUGE_PAGE aligned mapping advised for
+ *  transparent huge pages, then plain pages. Small arenas go straight
+ *  to plain pages. The arena is touched here so its pages are placed
+ *  on the NUMA node of the thread setting up the simulation.
+ */
+int* arena_alloc(VirtualMemory *vm, size_t bytes){
+    void *p;
+    size_t len = (bytes + HUGE_PAGE - 1) & ~(size_t) (HUGE_PAGE - 1);
+
+    vm->arena = NULL;
+#ifdef MAP_HUGETLB
+    if(bytes >= HUGE_PAGE){
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p != MAP_FAILED){
+            vm->arena = p;
+            vm->arena_len = len;
+            vm->arena_backing = "hugetlb";
+        }
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    if(vm->arena == NULL && bytes >= HUGE_PAGE){
+        // Over map by one huge page and trim both ends to get alignment
+        p = mmap(NULL, len + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p != MAP_FAILED){
+            char *start = (char*) (((uintptr_t) p + HUGE_PAGE - 1) & ~(uintptr_t) (HUGE_PAGE - 1));
+            if(start > (char*) p)
+                munmap(p, start - (char*) p);
+            munmap(start + len, (char*) p + len + HUGE_PAGE - start - len);
+            vm->arena = start;
+            vm->arena_len = len;
+            vm->arena_backing = (madvise(vm->arena, len, MADV_HUGEPAGE) == 0) ? "transparent huge pages" : "4KB pages";
+        }
+    }
+#endif
+    if(vm->arena == NULL){
+        len = (bytes > 0) ? bytes : 1;
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED) _errExit("mmap @arena_alloc");
+        vm->arena = p;
+        vm->arena_len = len;
+        vm->arena_backing = "4KB pages";
+    }
+
+    // First touch
+    for(size_t off = 0; off < vm->arena_len; off += 4096)
+        ((volatile char*) vm->arena)[off] = 0;
+
+    return vm->arena;
+}
+
+void arena_free(VirtualMemory *vm){
+    if(vm->arena != NULL)
+        munmap(vm->arena, vm->arena_len);
+    vm->arena = NULL;
+    vm->arena_len = 0;
+}
+
+/*=============================================
+=            Inverted Page Table              =
+=============================================*/
+
+/**
+ *  Allocates the frame table for n_pframes frames, all free.
+ *  Frames are also kept in per owner lists so local allocation
+ *  only scans the frames of its owner.
+ */
+void frames_init(VirtualMemory *vm){
+    frames_free(vm);
+
+    vm->ft.flags = calloc(vm->n_pframes, sizeof(unsigned int));
+    vm->ft.ref_epoch = calloc(vm->n_pframes, sizeof(unsigned int));
+    vm->ft.reference_time = calloc(vm->n_pframes, sizeof(unsigned int));
+    vm->ft.load_time = calloc(vm->n_pframes, sizeof(unsigned int));
+    vm->ft.vpn = malloc(sizeof(long long) * vm->n_pframes);
+    vm->ft.owner = malloc(sizeof(int) * vm->n_pframes);
+    vm->ft.owner_pos = calloc(vm->n_pframes, sizeof(long long));
+    vm->ft.generation = calloc(vm->n_pframes, sizeof(unsigned int));
+    vm->ft.age = calloc(vm->n_pframes, sizeof(int));
+    vm->all_frames = malloc(sizeof(long long) * vm->n_pframes);
+    if(vm->ft.flags == NULL || vm->ft.ref_epoch == NULL || vm->ft.reference_time == NULL || vm->ft.load_time == NULL || vm->ft.vpn == NULL ||
+       vm->ft.owner == NULL || vm->ft.owner_pos == NULL || vm->ft.generation == NULL || vm->ft.age == NULL || vm->all_frames == NULL)
+        _errExit("calloc @frames_init");
+
+    for(long long i = 0; i < vm->n_pframes; i++){
+        vm->ft.vpn[i] = -1;
+        vm->ft.owner[i] = -1;
+        vm->all_frames[i] = i;
+    }
+    for(int o = 0; o < vm->n_owners; o++){
+        vm->owner_frames[o] = malloc(sizeof(long long) * vm->n_pframes);
+        if(vm->owner_frames[o] == NULL) _errExit("malloc @frames_init");
+        vm->n_owner_frames[o] = 0;
+    }
+}
+
+void frames_free(VirtualMemory *vm){
+    free(vm->ft.flags);
+    free(vm->ft.ref_epoch);
+    free(vm->ft.reference_time);
+    free(vm->ft.load_time);
+    free(vm->ft.vpn);
+    free(vm->ft.owner);
+    free(vm->ft.owner_pos);
+    free(vm->ft.generation);
+    free(vm->ft.age);
+    memset(&vm->ft, 0, sizeof(vm->ft));
+    free(vm->all_frames);
+    vm->all_frames = NULL;
+    for(int o = 0; o < vm->n_owners; o++){
+        free(vm->owner_frames[o]);
+        vm->owner_frames[o] = NULL;
+    }
+}
+
+/*
+    Moves frame f to the frame list of owner
+*/
+void frame_set_owner(VirtualMemory *vm, long long f, int owner){
+    int old = vm->ft.owner[f];
+
+    if(old == owner)
+        return;
+
+    if(old >= 0){ // Swap with the last frame of the old owner
+        long long *list = vm->owner_frames[old];
+        long long last = list[--vm->n_owner_frames[old]];
+        list[vm->ft.owner_pos[f]] = last;
+        vm->ft.owner_pos[last] = vm->ft.owner_pos[f];
+    }
+
+    vm->ft.owner[f] = owner;
+    vm->ft.owner_pos[f] = vm->n_owner_frames[owner];
+    vm->owner_frames[owner][vm->n_owner_frames[owner]++] = f;
+}
+
+/*
+    Advances the logical clock and returns the new time as a 32-bit
+    timestamp for reference and load times. Every CLOCK_CLAMP ticks
+    older timestamps are pulled forward so comparing them with
+    time_before stays valid after the low 32 bits wrap.
+*/
+unsigned int vm_tick(VirtualMemory *vm){
+    if((unsigned int) ++vm->access_clock % CLOCK_CLAMP == 0)
+        clamp_times(vm);
+    return (unsigned int) vm->access_clock;
+}
+
+// n ticks of vm_tick at once, clamps if a CLOCK_CLAMP boundary is crossed
+unsigned int vm_advance(VirtualMemory *vm, unsigned long long n){
+    unsigned long long t = vm->access_clock;
+
+    vm->access_clock += n;
+    if(t / CLOCK_CLAMP != vm->access_clock / CLOCK_CLAMP)
+        clamp_times(vm);
+    return (unsigned int) vm->access_clock;
+}
+
+// Raises frame timestamps older than CLOCK_CLAMP ticks to that age, order among them is lost
+void clamp_times(VirtualMemory *vm){
+    unsigned int oldest = (unsigned int) vm->access_clock - CLOCK_CLAMP;
+
+    for(long long i = 0; i < vm->n_pframes; i++){
+        if(time_before(vm->ft.reference_time[i], oldest)) vm->ft.reference_time[i] = oldest;
+        if(time_before(vm->ft.load_time[i], oldest))      vm->ft.load_time[i] = oldest;
+    }
+}
+
+// 1 if timestamp t1 is older than t2
+int time_before(unsigned int t1, unsigned int t2){
+    return (int) (t1 - t2) < 0;
+}
+
+/*=============================================
+=            Radix Page Table                 =
+=============================================*/
+
+/**
+ *  Builds an empty radix page table for the num_virtual of vm.
+ *  Page number bits are split from the bottom, PT_BITS bits per lower
+ *  level and the rest to the root, with 2 to PT_MAX_LEVELS levels.
+ *  Only the root is allocated here, directories and leaves are allocated
+ *  on first touch so the table grows with the touched footprint.
+ */
+void pt_init(VirtualMemory *vm){
+    int remaining = vm->num_virtual;
+
+    vm->pt.page_size = vm->f_size;
+    vm->pt.levels = (vm->num_virtual + PT_BITS - 1) / PT_BITS;
+    if(vm->pt.levels < 2) vm->pt.levels = 2;
+    if(vm->pt.levels > PT_MAX_LEVELS) vm->pt.levels = PT_MAX_LEVELS;
+
+    for(int l = vm->pt.levels - 1; l > 0; l--){
+        vm->pt.bits[l] = (remaining < PT_BITS) ? remaining : PT_BITS;
+        remaining -= vm->pt.bits[l];
+    }
+    vm->pt.bits[0] = remaining;
+
+    vm->pt.shift[vm->pt.levels - 1] = 0;
+    for(int l = vm->pt.levels - 2; l >= 0; l--)
+        vm->pt.shift[l] = vm->pt.shift[l + 1] + vm->pt.bits[l + 1];
+
+    vm->pt.root = calloc(1LL << vm->pt.bits[0], sizeof(void*));
+    if(vm->pt.root == NULL) _errExit("calloc @pt_init");
+    vm->pt.pt_bytes = sizeof(void*) << vm->pt.bits[0];
+
+    vm->pt.n_leaves = 0;
+    vm->pt.cap_leaves = 0;
+    vm->pt.leaves = NULL;
+    vm->pt.leaf_base = NULL;
+
+    vm->tlb_hits = vm->tlb_misses = 0;
+    vm->sp_promotions = vm->sp_demotions = vm->sp_active = 0;
+}
+
+void pt_free_node(VirtualMemory *vm, void** node, int level){
+    if(node == NULL) return;
+    if(level < vm->pt.levels - 2){
+        for(long long i = 0; i < (1LL << vm->pt.bits[level]); i++)
+            pt_free_node(vm, node[i], level + 1);
+    }
+    free(node);
+}
+
+void pt_free(VirtualMemory *vm){
+    if(vm->pt.root == NULL) return;
+    for(long long i = 0; i < vm->pt.n_leaves; i++)
+        free(vm->pt.leaves[i]);
+    pt_free_node(vm, vm->pt.root, 0);
+    free(vm->pt.leaves);
+    free(vm->pt.leaf_base);
+    vm->pt.root = NULL;
+    vm->pt.leaves = NULL;
+    vm->pt.leaf_base = NULL;
+    vm->pt.n_leaves = vm->pt.cap_leaves = 0;
+}
+
+/*
+    Allocates a leaf covering the page numbers starting at base_vpn
+*/
+Entry* pt_alloc_leaf(VirtualMemory *vm, long long base_vpn){
+    long long n = 1LL << vm->pt.bits[vm->pt.levels - 1];
+    Entry* leaf = calloc(n, sizeof(Entry));   // All pages not present
+    if(leaf == NULL) _errExit("calloc @pt_alloc_leaf");
+
+    if(vm->pt.n_leaves == vm->pt.cap_leaves){
+        vm->pt.cap_leaves = (vm->pt.cap_leaves == 0) ? 16 : vm->pt.cap_leaves * 2;
+        vm->pt.leaves = realloc(vm->pt.leaves, sizeof(Entry*) * vm->pt.cap_leaves);
+        vm->pt.leaf_base = realloc(vm->pt.leaf_base, sizeof(long long) * vm->pt.cap_leaves);
+        if(vm->pt.leaves == NULL || vm->pt.leaf_base == NULL) _errExit("realloc @pt_alloc_leaf");
+    }
+    vm->pt.leaf_base[vm->pt.n_leaves] = base_vpn;
+    vm->pt.leaves[vm->pt.n_leaves++] = leaf;
+    vm->pt.pt_bytes += sizeof(Entry) * n;
+    return leaf;
+}
+
+/*
+    Walks the radix table down to the entry of page vpn, allocating
+    missing directories and the leaf on the way.
+*/
+Entry* pt_walk(VirtualMemory *vm, long long vpn){
+    void** node = vm->pt.root;
+    int last = vm->pt.levels - 1;
+
+    for(int l = 0; l < last; l++){
+        long long idx = (vpn >> vm->pt.shift[l]) & ((1LL << vm->pt.bits[l]) - 1);
+        if(node[idx] == NULL){
+            if(l == last - 1){
+                node[idx] = pt_alloc_leaf(vm, vpn & ~((1LL << vm->pt.bits[last]) - 1));
+            }
+            else{
+                node[idx] = calloc(1LL << vm->pt.bits[l + 1], sizeof(void*));
+                if(node[idx] == NULL) _errExit("calloc @pt_walk");
+                vm->pt.pt_bytes += sizeof(void*) << vm->pt.bits[l + 1];
+            }
+        }
+        node = node[idx];
+    }
+    return &((Entry*) node)[vpn & ((1LL << vm->pt.bits[last]) - 1)];
+}
+
+/*
+    Returns the page table entry of page vpn, recent translations are
+    served from the direct mapped translation caches, base pages first
+    then superpages. Entries never move while the table lives, so cached
+    pointers stay valid across evictions.
+*/
+Entry* pt_entry(long long vpn, Context *c){
+    VirtualMemory *vm = c->vm;
+    TLBEntry *t = &c->tlb[vpn & (TLB_SIZE - 1)];
+    TLBEntry *st = &c->stlb[(vpn >> SP_ORDER) & (STLB_SIZE - 1)];
+    Entry *e;
+
+    if(t->e != NULL && t->vpn == vpn){
+        vm->tlb_hits++;
+        return t->e;
+    }
+    if(st->e != NULL && st->vpn == vpn >> SP_ORDER){
+        vm->tlb_hits++;
+        return st->e + (vpn & (SP_PAGES - 1));
+    }
+    vm->tlb_misses++;
+    e = pt_walk(vm, vpn);
+    if(*e & PTE_SUPER){
+        st->vpn = vpn >> SP_ORDER;
+        st->e = e - (vpn & (SP_PAGES - 1));
+    }
+    else{
+        t->vpn = vpn;
+        t->e = e;
+    }
+    return e;
+}
+
+// # of entries in allocated leaves, the touched footprint
+long long pt_n_touched(VirtualMemory *vm){
+    return vm->pt.n_leaves << vm->pt.bits[vm->pt.levels - 1];
+}
+
+// Entry #i of the touched footprint, i < pt_n_touched(vm)
+Entry* pt_touched(VirtualMemory *vm, long long i){
+    int b = vm->pt.bits[vm->pt.levels - 1];
+    return &vm->pt.leaves[i >> b][i & ((1LL << b) - 1)];
+}
+
+// Page number of entry #i of the touched footprint
+long long pt_touched_vpn(VirtualMemory *vm, long long i){
+    int b = vm->pt.bits[vm->pt.levels - 1];
+    return vm->pt.leaf_base[i >> b] + (i & ((1LL << b) - 1));
+}
+
+void print_vm_stats(VirtualMemory *vm, FILE *out){
+    unsigned long long ft_bytes = vm->n_pframes * (4 * sizeof(unsigned int)                  // Hot
+                                  + 2 * sizeof(long long) + 3 * sizeof(int));      // Cold
+    fprintf(out, "Page table: %d levels, %lld leaves, %.2f KB\n", vm->pt.levels, vm->pt.n_leaves, vm->pt.pt_bytes/pow(2,10));
+    fprintf(out, "Frame table: %.2f KB\n", ft_bytes/pow(2,10));
+    fprintf(out, "Physical memory: %.2f KB, backed by %s\n", vm->arena_len/pow(2,10), vm->arena_backing);
+    unsigned long long reach = 0;
+    for(int i = 0; i < vm->n_contexts; i++)
+        reach += tlb_reach(vm->contexts[i]);
+    fprintf(out, "TLB hits: %llu, misses: %llu, reach: %.2f KB\n", vm->tlb_hits, vm->tlb_misses, sizeof(int) * reach/pow(2,10));
+    fprintf(out, "Superpages(%d pages): %lld promoted, %lld demoted, %lld active\n", SP_PAGES, vm->sp_promotions, vm->sp_demotions, vm->sp_active);
+    fprintf(out, "Logical clock: %llu ticks\n", vm->access_clock);
+}
+
+// Totals of vm and each of its shadows, the same page stream under every policy
+void print_shadow_stats(VirtualMemory *vm, FILE *out){
+    fprintf(out, "%-6s %-8s %12s %14s %12s %12s\n", "PR", "AP", "Misses", "Replacements", "DPW", "DPR");
+    for(int i = -1; i < vm->n_shadows; i++){
+        VirtualMemory *m = (i == -1) ? vm : vm->shadows[i];
+        Stats s = stats_total(m);
+
+        fprintf(out, "%-6s %-8s %12llu %14llu %12llu %12llu%s\n", PR_TYPES[m->pr], AP_TYPES[m->ap],
+                s.n_misses, s.n_replacements, s.n_dpw, s.n_dpr, (i == -1) ? " *" : "");
+    }
+}
+
+/*=============================================
+=            Superpages                       =
+=============================================*/
+
+/*
+    Superpages are SP_PAGES base pages, aligned in both the virtual and
+    the physical space. The first page of a group to fault reserves a
+    fully free aligned block of frames, its siblings take their own slot
+    of the block while it is free. A group is promoted when all of its
+    pages are resident in consecutive frames and referenced, then the
+    whole group is translated by a single superpage TLB entry and its
+    dirty pages are written back together. Replacement stays per base
+    page, evicting any page of the group demotes it back to base pages.
+*/
+
+// 1 if superpages fit the current geometry
+int sp_enabled(VirtualMemory *vm){
+    return vm->pt.bits[vm->pt.levels - 1] >= SP_ORDER && vm->n_pframes >= SP_PAGES;
+}
+
+// Promotes the group of page vpn if it qualifies
+void sp_try_promote(VirtualMemory *vm, long long vpn){
+    long long g = vpn & ~(SP_PAGES - 1);
+    Entry *e;
+    long long f;
+
+    if(!sp_enabled(vm) || g + SP_PAGES > vm->n_vframes)
+        return;
+
+    e = pt_walk(vm, g);     // Group never crosses a leaf
+    f = PTE_FRAME(e[0]);
+    if(f % SP_PAGES != 0)
+        return;
+    for(int i = 0; i < SP_PAGES; i++){
+        if(!(e[i] & PTE_PRESENT) || PTE_FRAME(e[i]) != f + i || !FR_REFERENCED(vm, f + i))
+            return;
+    }
+
+    for(int i = 0; i < SP_PAGES; i++)
+        e[i] |= PTE_SUPER;
+    vm->sp_promotions++;
+    vm->sp_active++;
+    debug("Promoted pages [%lld, %lld] to a superpage\n", g, g + SP_PAGES - 1);
+}
+
+// Splits the superpage holding page vpn back to base pages
+void sp_demote(VirtualMemory *vm, long long vpn){
+    long long g = vpn & ~(SP_PAGES - 1);
+    Entry *e = pt_walk(vm, vpn) - (vpn - g);
+    TLBEntry *st;
+
+    for(int i = 0; i < SP_PAGES; i++)
+        e[i] &= ~PTE_SUPER;
+    for(int i = 0; i < vm->n_contexts; i++){
+        st = &vm->contexts[i]->stlb[(g >> SP_ORDER) & (STLB_SIZE - 1)];
+        if(st->e == e)
+            st->e = NULL;
+    }
+    vm->sp_demotions++;
+    vm->sp_active--;
+    debug("Demoted superpage [%lld, %lld]\n", g, g + SP_PAGES - 1);
+}
+
+/*
+    Writes back the dirty pages of the superpage around page vpn with one
+    write, the run of modified unpinned pages holding vpn. Frames and pages
+    of a superpage are both consecutive so the run is one disk range.
+    mutex_access must be held.
+*/
+void sp_write_back(VirtualMemory *vm, long long vpn){
+    long long g = vpn & ~(SP_PAGES - 1);
+    long long f = PTE_FRAME(*pt_walk(vm, g));
+    int lo = vpn - g, hi = vpn - g;
+
+    #define SP_DIRTY(i) ((vm->ft.flags[f + (i)] & FR_MODIFIED) && FR_PINNED(vm->ft.flags[f + (i)]) == 0)
+    while(lo > 0 && SP_DIRTY(lo - 1)) lo--;
+    while(hi < SP_PAGES - 1 && SP_DIRTY(hi + 1)) hi++;
+    #undef SP_DIRTY
+
+    debug("Writing back pages [%lld, %lld] of a superpage\n", g + lo, g + hi);
+    fseeko(vm->fd, (off_t) sizeof(int) * vm->f_size * (g + lo), SEEK_SET);      if(errno < 0) _errExit("Error: fseeko @sp_write_back");
+    fwrite(&vm->memory[(f + lo) * vm->f_size], sizeof(int), (size_t) vm->f_size * (hi - lo + 1), vm->fd);  if(errno < 0) _errExit("Error: fwrite @sp_write_back");
+    for(int i = lo; i <= hi; i++)
+        vm->ft.flags[f + i] &= ~FR_MODIFIED;
+}
+
+// First frame of a fully free aligned block, -1 if none is left
+static long long sp_free_block(VirtualMemory *vm){
+    const unsigned long long mask = (1ULL << SP_PAGES) - 1;
+
+    // Frames are never freed, blocks skipped once stay used
+    while(vm->sp_block_hint < vm->n_pframes / SP_PAGES){
+        long long b = vm->sp_block_hint * SP_PAGES;
+
+        if(((vm->bitmap[b / 64] >> (b % 64)) & mask) == mask)
+            return b;
+        vm->sp_block_hint++;
+    }
+    return -1;
+}
+
+/*
+    Returns a free frame for page vpn, -1 if none is free. The slot of vpn
+    in the block reserved by its group if that is free, else a new block
+    if the group has no resident page. Once no free block is left faults
+    take the lowest free frame and break into reservations.
+*/
+long long sp_place(VirtualMemory *vm, long long vpn){
+    long long g = vpn & ~(SP_PAGES - 1);
+    long long j = find_free_addr(vm), b;
+    Entry *e;
+
+    if(j == -1 || !sp_enabled(vm) || g + SP_PAGES > vm->n_vframes)
+        return j;
+
+    e = pt_walk(vm, g);
+    for(int i = 0; i < SP_PAGES; i++){
+        if(!(e[i] & PTE_PRESENT))
+            continue;
+        b = PTE_FRAME(e[i]) - i + (vpn - g);   // Slot of vpn next to a resident sibling
+        if((PTE_FRAME(e[i]) - i) % SP_PAGES == 0 && (vm->bitmap[b / 64] >> (b % 64)) & 1)
+            return b;
+        return j;
+    }
+    b = sp_free_block(vm);
+    return (b == -1) ? j : b + (vpn - g);
+}
+
+// Drops the base page translation of vpn from every context
+void tlb_shootdown(VirtualMemory *vm, long long vpn){
+    TLBEntry *t;
+
+    for(int i = 0; i < vm->n_contexts; i++){
+        t = &vm->contexts[i]->tlb[vpn & (TLB_SIZE - 1)];
+        if(t->vpn == vpn)
+            t->e = NULL;
+    }
+}
+
+/*
+    Memory covered by the valid TLB entries of c in integers. Entries are
+    dropped when their page leaves, so only resident pages count.
+*/
+unsigned long long tlb_reach(Context *c){
+    VirtualMemory *vm = c->vm;
+    unsigned long long reach = 0;
+
+    for(int i = 0; i < TLB_SIZE; i++)
+        if(c->tlb[i].e != NULL) reach += vm->f_size;
+    for(int i = 0; i < STLB_SIZE; i++)
+        if(c->stlb[i].e != NULL) reach += (unsigned long long) vm->f_size * SP_PAGES;
+    return reach;
+}
+
+void print_stats(FILE *out, const Stats *s){
+    fprintf(out, "#%d - %s stats\n"
+            "# Reads: %llu\n"
+            "# Writes: %llu\n"
+            "# Misses: %llu\n"
+            "# Replacements: %llu\n"
+            "# DPW: %llu\n"
+            "# DPR: %llu\n"
+            "# Pins: %llu\n",
+            s->owner, s->name, s->n_reads, s->n_writes, s->n_misses, s->n_replacements, s->n_dpw, s->n_dpr, s->n_pins);
+}
+
+// Appends an access of c to the trace if recording. mutex_access must be held.
+static inline void vm_trace(Context *c, int op, unsigned long long index, unsigned long long a, unsigned long long b){
+    if(c->vm->trace != NULL)
+        trace_event(c->vm->trace, c->index, op, index, a, b);
+}
+
+/**
+ *  Returns a copy of the integer at index. If the integer is not
+ *  in phscial memory, pulls page to the memory.
+ *  If the memory is full, a page replacement algorithm is called.
+ *  Write back is handled if necessary.
+ */
+int get(unsigned long long index, Context *c){
+    VirtualMemory *vm = c->vm;
+    pthread_mutex_lock(&vm->mutex_access);
+    int result = -1;
+    long long j;
+
+    if(index >= vm->n_words) _errExit("Error: Index out of range @get");
+
+    STATS_CHARGE(c, n_reads, 1);
+    vm_trace(c, T_GET, index, 0, 0);
+
+    j = page_in(index, c, 0);
+    result = vm->memory[j * vm->f_size + index%vm->f_size];
+
+    pthread_mutex_unlock(&vm->mutex_access);
+    return result;
+}
+
+void set(unsigned long long index, int value, Context *c){
+    VirtualMemory *vm = c->vm;
+    pthread_mutex_lock(&vm->mutex_access);
+    long long j;
+
+    if(index >= vm->n_words) _errExit("Error: Index out of range @set");
+
+    STATS_CHARGE(c, n_writes, 1);
+    vm_trace(c, T_SET, index, 0, 0);
+
+    j = page_in(index, c, 1);
+    vm->memory[j * vm->f_size + index%vm->f_size] = value;
+
+    pthread_mutex_unlock(&vm->mutex_access);
+}
+
+/*
+    Feeds a page reference of c to the miss ratio curve recorders and
+    shadow machines that are on. mutex_access must be held.
+*/
+static inline void vm_record(VirtualMemory *vm, long long vpn, int write, Context *c){
+    if(vm->mrc != NULL)
+        mrc_access(vm->mrc, vpn);
+    if(vm->shards != NULL)
+        shards_access(vm->shards, vpn);
+    for(int i = 0; i < vm->n_shadows; i++){
+        VirtualMemory *sh = vm->shadows[i];
+        Context *sc = sh->contexts[c->index];
+
+        page_in((unsigned long long) vpn * sh->f_size, sc, write);
+    }
+}
+
+// vm_record of n references in a row to page vpn
+static inline void vm_record_run(VirtualMemory *vm, long long vpn, int write, Context *c, unsigned long long n){
+    if(vm->mrc == NULL && vm->shards == NULL && vm->n_shadows == 0)
+        return;
+    for(unsigned long long i = 0; i < n; i++)
+        vm_record(vm, vpn, write, c);
+}
+
+/*
+    Marks frame j referenced(and modified on write) at the current
+    logical time, the hit path of every access
+*/
+inline void frame_touch(VirtualMemory *vm, long long j, int write){
+    if(write) vm->ft.flags[j] |= FR_MODIFIED;
+    FR_SET_R(vm, j);
+    vm->ft.reference_time[j] = vm_tick(vm);
+    if(vm->policy->on_hit != NULL)
+        vm->policy->on_hit(vm, j, write);
+}
+
+/**
+ *  Makes the page covering index present in physical memory and returns
+ *  its frame number with R(and M on write) bits and times updated.
+ *  On a miss the page is read from disk, if the memory is full a page
+ *  replacement algorithm picks the victim frame and write back is handled.
+ *  Misses are counted as DPW on write and DPR on read.
+ *  mutex_access must be held by the caller.
+ */
+long long page_in(unsigned long long index, Context *c, int write){
+    VirtualMemory *vm = c->vm;
+    long long k, j;
+    Entry *e;
+
+    // Uncharged cursor accesses of c came first
+    if(c->run_frame != -1)
+        ctx_charge_run(c);
+
+    // Get table entry that covering given index
+    k = to_addr_space(vm, index);
+    e = pt_entry(k, c);
+
+    // If integer in physcial memory
+    if(*e & PTE_PRESENT){
+        debug("Index %llu in memory\n", index);
+        j = PTE_FRAME(*e);
+        frame_set_owner(vm, j, c->owner);
+        frame_touch(vm, j, write);
+        vm_record(vm, k, write, c);
+        return j;
+    }
+
+    // If integer in virtual memory
+    debug("Index %llu not in memory\n", index);
+    // Is there a free spot on memory
+    j = sp_place(vm, k);
+    if(j == -1){
+        debug("No free spots, running PR algorithm\n");
+        // Find frame to swap, if every candidate is pinned wait for an unpin
+        while((j = find_victim(vm, c->owner)) == -1){
+            // Pages held by our own cursors first, we can not wait on ourselves
+            if(ctx_release_cursors(c) > 0)
+                continue;
+            if(vm->n_pinned == 0)
+                _errExit("Page replacement error");
+            debug("All frames pinned, waiting\n");
+            pthread_cond_wait(&vm->cond_unpin, &vm->mutex_access);
+            if(*e & PTE_PRESENT) // Brought in by another thread meanwhile
+                return page_in(index, c, write);
+        }
+    }
+
+    STATS_BEGIN(c);
+    STATS_ADD(c, n_misses, 1);
+    if(write) STATS_ADD(c, n_dpw, 1);
+    else      STATS_ADD(c, n_dpr, 1);
+    if(vm->ft.vpn[j] != -1)
+        STATS_ADD(c, n_replacements, 1);
+    STATS_END(c);
+
+    if(vm->ft.vpn[j] == -1){
+        debug("Free spot found at frame #%lld\n", j);
+        vm->bitmap[j / 64] &= ~(1ULL << (j % 64));   // Occupied now
+    }
+    else{
+        debug("replacing page #%lld in frame #%lld\n", vm->ft.vpn[j], j);
+
+        // Write back if necessary, shadows have no disk
+        if((vm->ft.flags[j] & FR_MODIFIED) && vm->primary == NULL && (*pt_walk(vm, vm->ft.vpn[j]) & PTE_SUPER))
+            sp_write_back(vm, vm->ft.vpn[j]);
+        else if((vm->ft.flags[j] & FR_MODIFIED) && vm->primary == NULL){
+            debug("Page %lld is modified, write back required\n", vm->ft.vpn[j]);
+            // Write back required, ram to disk
+            fseeko(vm->fd, (off_t) sizeof(int) * vm->f_size * vm->ft.vpn[j], SEEK_SET);     if(errno < 0) _errExit("Error: fseeko @page_in");
+            fwrite(&vm->memory[j * vm->f_size], sizeof(int), vm->f_size, vm->fd); if(errno < 0) _errExit("Error: fwrite @page_in");
+        }
+
+        // Old page
+        if(vm->policy->on_evict != NULL)
+            vm->policy->on_evict(vm, j);
+        if(*pt_walk(vm, vm->ft.vpn[j]) & PTE_SUPER)
+            sp_demote(vm, vm->ft.vpn[j]);
+        tlb_shootdown(vm, vm->ft.vpn[j]);
+        *pt_walk(vm, vm->ft.vpn[j]) = 0;
+    }
+
+    // New page
+    vm->ft.vpn[j] = k;
+    vm->ft.generation[j]++;
+    vm->ft.age[j] = 0;
+    vm->ft.flags[j] = write ? (FR_USED | FR_MODIFIED) : FR_USED;
+    FR_SET_R(vm, j);
+    vm->ft.reference_time[j] = vm->ft.load_time[j] = vm_tick(vm);
+    vm_record(vm, k, write, c);
+    frame_set_owner(vm, j, c->owner);
+    *e = PTE_PRESENT | (Entry) j;
+
+    // Disk to ram
+    if(vm->primary == NULL){
+        fseeko(vm->fd, (off_t) sizeof(int) * vm->f_size * k, SEEK_SET);        if(errno < 0)  _errExit("Error: fseeko @page_in");
+        fread(&vm->memory[j * vm->f_size], sizeof(int),vm->f_size, vm->fd);  if(errno < 0)  _errExit("Error: fread @page_in");
+    }
+
+    if(vm->policy->on_fault != NULL)
+        vm->policy->on_fault(vm, j, write);
+    sp_try_promote(vm, k);
+    return j;
+}
+
+/**
+ *  Bulk versions of get/set, len integers starting at index start are
+ *  moved between buf and the virtual memory page by page with memcpy.
+ *  mutex_access is taken, the page resolved and R/M bits updated once
+ *  per page touched. Reads/writes are still counted per integer so stats
+ *  stay comparable with get/set.
+ */
+void get_range(unsigned long long start, unsigned long long len, int* buf, Context *c){
+    VirtualMemory *vm = c->vm;
+    unsigned long long i = start, end = start + len, n;
+    long long j;
+
+    if(end > vm->n_words || end < start) _errExit("Error: Index out of range @get_range");
+
+    while(i < end){
+        n = vm->f_size - i%vm->f_size;
+        if(n > end - i) n = end - i;
+
+        pthread_mutex_lock(&vm->mutex_access);
+        STATS_CHARGE(c, n_reads, n);
+        vm_trace(c, T_GET_RANGE, i, n, 0);
+        j = page_in(i, c, 0);
+        memcpy(buf, &vm->memory[j * vm->f_size + i%vm->f_size], sizeof(int) * n);
+        pthread_mutex_unlock(&vm->mutex_access);
+
+        buf += n;
+        i += n;
+    }
+}
+
+void set_range(unsigned long long start, unsigned long long len, const int* buf, Context *c){
+    VirtualMemory *vm = c->vm;
+    unsigned long long i = start, end = start + len, n;
+    long long j;
+
+    if(end > vm->n_words || end < start) _errExit("Error: Index out of range @set_range");
+
+    while(i < end){
+        n = vm->f_size - i%vm->f_size;
+        if(n > end - i) n = end - i;
+
+        pthread_mutex_lock(&vm->mutex_access);
+        STATS_CHARGE(c, n_writes, n);
+        vm_trace(c, T_SET_RANGE, i, n, 0);
+        j = page_in(i, c, 1);
+        memcpy(&vm->memory[j * vm->f_size + i%vm->f_size], buf, sizeof(int) * n);
+        pthread_mutex_unlock(&vm->mutex_access);
+
+        buf += n;
+        i += n;
+    }
+}
+
+/**
+ *  Copies len integers from src to dst inside the virtual memory, ranges
+ *  may overlap(memmove semantics). Source and destination pages can not be
+ *  assumed resident at the same time, each piece is staged through a
+ *  buffer of one frame.
+ */
+void copy_range(unsigned long long dst, unsigned long long src, unsigned long long len, Context *c){
+    VirtualMemory *vm = c->vm;
+    unsigned long long done = 0, n, s_i, d_i;
+    int backward = (dst > src && dst - src < len);
+    int* buf;
+
+    if(src + len > vm->n_words || src + len < src) _errExit("Error: Index out of range @copy_range");
+    if(dst + len > vm->n_words || dst + len < dst) _errExit("Error: Index out of range @copy_range");
+
+    buf = malloc(sizeof(int) * vm->f_size);
+    if(buf == NULL) _errExit("Error: malloc @copy_range");
+
+    while(done < len){
+        if(!backward){
+            s_i = src + done;
+            d_i = dst + done;
+            // Largest piece that stays inside both the source and destination page
+            n = vm->f_size - ((s_i%vm->f_size > d_i%vm->f_size) ? s_i%vm->f_size : d_i%vm->f_size);
+            if(n > len - done) n = len - done;
+        }
+        else{
+            // Overlapping with dst after src, copy from the end
+            unsigned long long s_room = (src + len - done - 1)%vm->f_size + 1;
+            unsigned long long d_room = (dst + len - done - 1)%vm->f_size + 1;
+            n = (s_room < d_room) ? s_room : d_room;
+            if(n > len - done) n = len - done;
+            s_i = src + len - done - n;
+            d_i = dst + len - done - n;
+        }
+
+        get_range(s_i, n, buf, c);
+        set_range(d_i, n, buf, c);
+        done += n;
+    }
+
+    free(buf);
+}
+
+/**
+ *  Pins the page covering index and returns a span from index to the end
+ *  of that page. The page is brought in if necessary, R bit(and M bit for
+ *  PIN_WRITE) is set and it will not be selected by page replacement until
+ *  unpinned. The span must not be used after unpin.
+ *  A thread must not call get/set while holding a pin.
+ */
+Span pin(unsigned long long index, int mode, Context *c){
+    VirtualMemory *vm = c->vm;
+    Span sp = {0};
+    long long j;
+
+    pthread_mutex_lock(&vm->mutex_access);
+    if(index >= vm->n_words) _errExit("Error: Index out of range @pin");
+
+    STATS_CHARGE(c, n_pins, 1);
+    vm_trace(c, mode == PIN_WRITE ? T_PIN_WRITE : T_PIN_READ, index, 0, 0);
+
+    j = page_in(index, c, mode == PIN_WRITE);
+    frame_pin(vm, j);
+
+    sp.data = &vm->memory[j * vm->f_size + index%vm->f_size];
+    sp.start = index;
+    sp.len = vm->f_size - index%vm->f_size;
+    sp.frame = j;
+
+    pthread_mutex_unlock(&vm->mutex_access);
+    return sp;
+}
+
+/**
+ *  Releases a span taken with pin. Reads and writes recorded on the span
+ *  are charged to the thread stats, recorded writes mark the page modified.
+ */
+void unpin(Span *sp, Context *c){
+    VirtualMemory *vm = c->vm;
+    long long j = sp->frame;
+
+    pthread_mutex_lock(&vm->mutex_access);
+    STATS_BEGIN(c);
+    STATS_ADD(c, n_reads, sp->n_reads);
+    STATS_ADD(c, n_writes, sp->n_writes);
+    STATS_END(c);
+    vm_trace(c, T_UNPIN, sp->start, sp->n_reads, sp->n_writes);
+
+    if(sp->n_reads || sp->n_writes){
+        frame_touch(vm, j, sp->n_writes != 0);
+        vm_record(vm, vm->ft.vpn[j], sp->n_writes != 0, c);
+    }
+
+    frame_unpin(vm, j);
+
+    sp->data = NULL;
+    sp->n_reads = sp->n_writes = 0;
+    pthread_mutex_unlock(&vm->mutex_access);
+}
+
+// Pins frame j, page replacement skips it until unpinned. mutex_access must be held.
+static void frame_pin(VirtualMemory *vm, long long j){
+    if(FR_PINNED(vm->ft.flags[j]) == 0){
+        vm->n_pinned++;
+        if(vm->n_pinned > vm->max_pinned) vm->max_pinned = vm->n_pinned;
+    }
+    vm->ft.flags[j] += FR_PIN_ONE;
+}
+
+static void frame_unpin(VirtualMemory *vm, long long j){
+    vm->ft.flags[j] -= FR_PIN_ONE;
+    if(FR_PINNED(vm->ft.flags[j]) == 0){
+        vm->n_pinned--;
+        pthread_cond_broadcast(&vm->cond_unpin);
+    }
+}
+
+/**
+ *  Sequential access cursor. The cursor pins the page it is on, so
+ *  read/write there skip the lock and the VM entirely and only count the
+ *  access. The pin is dropped as soon as the index leaves the page or
+ *  the cursor is closed, every cursor must be closed. While recording a
+ *  trace each access takes the locked path to get its own event.
+ */
+void cursor_open(Cursor *cur, unsigned long long index, Context *c){
+    cur->c = c;
+    cur->index = index;
+    cur->frame = -1;
+    cur->base = NULL;
+    cur->lo = cur->hi = 0;
+    cur->generation = 0;
+    cur->n_reads = cur->n_writes = 0;
+    // Only the thread of c touches its list
+    cur->next = c->cursors;
+    c->cursors = cur;
+}
+
+void cursor_close(Cursor *cur){
+    VirtualMemory *vm = cur->c->vm;
+    Cursor **p = &cur->c->cursors;
+
+    pthread_mutex_lock(&vm->mutex_access);
+    cursor_release(cur);
+    pthread_mutex_unlock(&vm->mutex_access);
+
+    while(*p != cur)
+        p = &(*p)->next;
+    *p = cur->next;
+}
+
+// Moves cur to index, leaving the pinned page releases it
+void cursor_seek(Cursor *cur, unsigned long long index){
+    VirtualMemory *vm = cur->c->vm;
+
+    cur->index = index;
+    if(cur->frame != -1 && index - cur->lo >= cur->hi - cur->lo){
+        pthread_mutex_lock(&vm->mutex_access);
+        cursor_release(cur);
+        pthread_mutex_unlock(&vm->mutex_access);
+    }
+}
+
+void cursor_next(Cursor *cur){ cursor_seek(cur, cur->index + 1); }
+void cursor_prev(Cursor *cur){ cursor_seek(cur, cur->index - 1); }
+
+/*
+    Charges the run of c, the accesses its cursors counted on run_frame
+    since the last charge. Nothing else of c was accessed in between, so
+    they are charged as that many references in a row. The clock moves a
+    tick per access, the touch stamps the last one, the first reference
+    keeps its own read/write for the recorders and shadows. mutex_access
+    must be held.
+*/
+static void ctx_charge_run(Context *c){
+    VirtualMemory *vm = c->vm;
+    long long j = c->run_frame;
+    unsigned long long n = 0, n_writes = 0;
+
+    if(j == -1)
+        return;
+    for(Cursor *cur = c->cursors; cur != NULL; cur = cur->next){
+        if(cur->frame != j)
+            continue;
+        if(vm->ft.generation[j] != cur->generation) _errExit("Error: Pinned frame replaced @ctx_charge_run");
+        n += cur->n_reads + cur->n_writes;
+        n_writes += cur->n_writes;
+        cur->n_reads = cur->n_writes = 0;
+    }
+    STATS_BEGIN(c);
+    STATS_ADD(c, n_reads, n - n_writes);
+    STATS_ADD(c, n_writes, n_writes);
+    STATS_END(c);
+    c->run_frame = -1;
+    if(n == 0)
+        return;
+
+    vm_advance(vm, n - 1);
+    frame_set_owner(vm, j, c->owner);
+    frame_touch(vm, j, n_writes != 0);
+    if(vm->policy->on_hit != NULL){
+        for(unsigned long long i = 1; i < n; i++)
+            vm->policy->on_hit(vm, j, n_writes != 0);
+    }
+    vm_record(vm, vm->ft.vpn[j], c->run_write, c);
+    vm_record_run(vm, vm->ft.vpn[j], n_writes != 0, c, n - 1);
+}
+
+/*
+    Charges the run of the context of cur and unpins its page. The frame
+    can not have changed while pinned, the generation check catches it if
+    it did. mutex_access must be held.
+*/
+static void cursor_release(Cursor *cur){
+    VirtualMemory *vm = cur->c->vm;
+    long long j = cur->frame;
+
+    if(j == -1)
+        return;
+    if(cur->c->run_frame == j)
+        ctx_charge_run(cur->c);
+    if(vm->ft.generation[j] != cur->generation) _errExit("Error: Pinned frame replaced @cursor_release");
+
+    frame_unpin(vm, j);
+    cur->frame = -1;
+}
+
+// Releases every cursor of c, returns how many held a page. mutex_access must be held.
+static int ctx_release_cursors(Context *c){
+    int n = 0;
+
+    for(Cursor *cur = c->cursors; cur != NULL; cur = cur->next){
+        if(cur->frame != -1){
+            cursor_release(cur);
+            n++;
+        }
+    }
+    return n;
+}
+
+/*
+    Moves the pin of cur to the page under the cursor, the access is
+    charged by page_in right away. mutex_access must be held.
+*/
+long long cursor_page(Cursor *cur, int write){
+    VirtualMemory *vm = cur->c->vm;
+    long long j = cur->frame;
+
+    ctx_charge_run(cur->c);     // Older than this access
+    if(j != -1 && cur->index >= cur->lo && cur->index < cur->hi){
+        // Still on the page, another page of c was accessed since or tracing
+        frame_set_owner(vm, j, cur->c->owner);
+        frame_touch(vm, j, write);
+        vm_record(vm, vm->ft.vpn[j], write, cur->c);
+        return j;
+    }
+
+    if(cur->index >= vm->n_words) _errExit("Error: Index out of range @cursor");
+
+    cursor_release(cur);
+    j = page_in(cur->index, cur->c, write);
+    frame_pin(vm, j);
+    cur->frame = j;
+    cur->lo = to_addr_space(vm, cur->index) * vm->f_size;
+    cur->hi = cur->lo + vm->f_size;
+    cur->generation = vm->ft.generation[j];
+    cur->base = &vm->memory[j * vm->f_size];
+    return j;
+}
+
+/*
+    Fast path of read/write, the pinned page of cur covers index and no
+    other page of the context has uncharged accesses. The first hit opens
+    the run of the context, only the thread of c touches it.
+*/
+static inline int cursor_hit(Cursor *cur, int write){
+    Context *c = cur->c;
+
+    if(cur->frame == -1 || cur->index - cur->lo >= cur->hi - cur->lo || c->vm->trace != NULL)
+        return 0;
+    if(c->run_frame != cur->frame){
+        if(c->run_frame != -1)
+            return 0;
+        c->run_frame = cur->frame;
+        c->run_write = write;
+    }
+    return 1;
+}
+
+int cursor_read(Cursor *cur){
+    VirtualMemory *vm = cur->c->vm;
+    int result;
+
+    if(cursor_hit(cur, 0)){
+        cur->n_reads++;
+        return cur->base[cur->index - cur->lo];
+    }
+
+    pthread_mutex_lock(&vm->mutex_access);
+    cursor_page(cur, 0);
+    STATS_CHARGE(cur->c, n_reads, 1);
+    vm_trace(cur->c, T_GET, cur->index, 0, 0);
+    result = cur->base[cur->index - cur->lo];
+    pthread_mutex_unlock(&vm->mutex_access);
+    return result;
+}
+
+void cursor_write(Cursor *cur, int value){
+    VirtualMemory *vm = cur->c->vm;
+
+    if(cursor_hit(cur, 1)){
+        cur->n_writes++;
+        cur->base[cur->index - cur->lo] = value;
+        return;
+    }
+
+    pthread_mutex_lock(&vm->mutex_access);
+    cursor_page(cur, 1);
+    STATS_CHARGE(cur->c, n_writes, 1);
+    vm_trace(cur->c, T_SET, cur->index, 0, 0);
+    cur->base[cur->index - cur->lo] = value;
+    pthread_mutex_unlock(&vm->mutex_access);
+}
+
+/*=============================================
+=            Trace Replay                     =
+=============================================*/
+
+// Replay state of one traced thread
+typedef struct{
+    TraceReader* r;
+    int thread;
+    Context* c;
+    Span sp;                // Open pin of the thread, one at most
+    int* buf;               // Staging for range events, a frame at most
+    unsigned long long n_events;
+} Replayer;
+
+// Issues a traced access again, set writes zeros since values are not traced
+static inline void replay_event(Replayer *rp, const TraceEvent *e){
+    switch(e->op){
+        case T_GET:       get(e->index, rp->c); break;
+        case T_SET:       set(e->index, 0, rp->c); break;
+        case T_GET_RANGE: get_range(e->index, e->a, rp->buf, rp->c); break;
+        case T_SET_RANGE: set_range(e->index, e->a, rp->buf, rp->c); break;
+        case T_PIN_READ:  rp->sp = pin(e->index, PIN_READ, rp->c); break;
+        case T_PIN_WRITE: rp->sp = pin(e->index, PIN_WRITE, rp->c); break;
+        case T_UNPIN:
+            rp->sp.n_reads = e->a;
+            rp->sp.n_writes = e->b;
+            unpin(&rp->sp, rp->c);
+            break;
+        default: _errExit("Error: Bad event @replay_event");
+    }
+    rp->n_events++;
+}
+
+// Replays the events of one thread as fast as they decode
+static void *thread_replay(void *arg){
+    Replayer *rp = arg;
+    TraceEvent e;
+
+    while(trace_next_thread(rp->r, rp->thread, &e))
+        replay_event(rp, &e);
+    pthread_exit(0);
+}
+
+/**
+ *  Feeds the events of trace r into vm bypassing the code that made
+ *  them, traced thread i runs as vm->contexts[i]. Interleaved replay
+ *  issues every event in event number order from one thread, so a
+ *  policy without clock interrupts ends up with the Stats of the traced
+ *  run. Otherwise every traced thread gets a thread of its own and the
+ *  interleaving is left to the scheduler. Returns the events replayed.
+ */
+unsigned long long vm_replay(VirtualMemory *vm, TraceReader *r, int interleaved){
+    int n = trace_n_threads(r);
+    Replayer *rps = calloc(n, sizeof(Replayer));
+    pthread_t *ids = malloc(sizeof(pthread_t) * n);
+    unsigned long long total = 0;
+    TraceEvent e;
+
+    if(rps == NULL || ids == NULL) _errExit("malloc @vm_replay");
+    if(n > vm->n_contexts) _errExit("Error: Trace has more threads than contexts @vm_replay");
+    for(int i = 0; i < n; i++){
+        rps[i].r = r;
+        rps[i].thread = i;
+        rps[i].c = vm->contexts[i];
+        rps[i].buf = malloc(sizeof(int) * vm->f_size);
+        if(rps[i].buf == NULL) _errExit("malloc @vm_replay");
+    }
+
+    if(interleaved){
+        while(trace_next(r, &e))
+            replay_event(&rps[e.thread], &e);
+    }
+    else{
+        for(int i = 0; i < n; i++)
+            pthread_create(&ids[i], NULL, thread_replay, &rps[i]);
+        for(int i = 0; i < n; i++)
+            pthread_join(ids[i], NULL);
+    }
+
+    for(int i = 0; i < n; i++){
+        total += rps[i].n_events;
+        free(rps[i].buf);
+    }
+    free(rps);
+    free(ids);
+    return total;
+}
+
+/*
+    Used to determine page table entry index using the virtual address(i)
+    Example for frame size 4096
+    i: 1        -> 0
+    i: 4096     -> 1
+    i: 6144     -> 1
+    i: 8192     -> 2
+    i: 10240    -> 2
+*/
+long long to_addr_space(VirtualMemory *vm, unsigned long long i){
+    return (i/vm->f_size);   // By the power of int division(truncation towards zero)
+}
+
+/*
+    Victim scans. Each takes the candidate frames as list[0..n), frames
+    that are free or pinned are skipped. With direct set list is every
+    frame in order and is not read, the constant argument lets the
+    compiler build a separate global and local version of each scan.
+*/
+static inline long long nru_scan(VirtualMemory *vm, const long long* list, long long n, int direct){
+    long long best[4] = {-1, -1, -1, -1};    // First frame of each class
+    long long f;
+    unsigned int fl;
+
+    for(long long i = 0; i < n; i++) {
+        f = direct ? i : list[i];
+        fl = vm->ft.flags[f];
+        if(!(fl & FR_USED) || FR_PINNED(fl))
+            continue;
+        // CLASS 0: !referenced && !modified, 1: !referenced && modified
+        // CLASS 2: referenced && !modified,  3: referenced && modified
+        int c = (FR_REFERENCED(vm, f) ? 2 : 0) + ((fl & FR_MODIFIED) ? 1 : 0);
+        if(best[c] == -1){
+            best[c] = f;
+            if(c == 0)
+                break;
+        }
+    }
+
+    for(int c = 0; c < 4; c++){
+        if(best[c] != -1)
+            return best[c];
+    }
+    return -1;
+}
+
+static inline long long fifo_scan(VirtualMemory *vm, const long long* list, long long n, int direct){
+    long long f, k = -1;
+    unsigned int tmin = 0;
+
+    for(long long i = 0; i < n; i++) {
+        f = direct ? i : list[i];
+        if(!(vm->ft.flags[f] & FR_USED) || FR_PINNED(vm->ft.flags[f]))
+            continue;
+        if(k == -1 || time_before(vm->ft.load_time[f], tmin)){
+            tmin = vm->ft.load_time[f];
+            k = f;
+        }
+    }
+    return k;
+}
+
+static inline long long sc_scan(VirtualMemory *vm, const long long* list, long long n, int direct){
+    long long f, k = -1, j = -1;
+    int reserved = 0, found = 0;
+    unsigned int tmin = 0;
+
+    for(long long i = 0; i < n; i++) {
+        f = direct ? i : list[i];
+        if(!(vm->ft.flags[f] & FR_USED) || FR_PINNED(vm->ft.flags[f]))
+            continue;
+        if(!found || time_before(vm->ft.load_time[f], tmin)){
+            found = 1;
+            if(FR_REFERENCED(vm, f)){ // If referenced, clear R bit and update load time
+                FR_CLEAR_R(vm, f);
+                vm->ft.load_time[f] = vm_tick(vm);
+                if (reserved == 0){ // This would the tail if the structe was a linked list
+                    reserved = 1;
+                    j = f;  // Will return this if all present pages are referenced(tail)
+                }
+            }
+            else{   // Update oldest unreferenced page
+                k = f;
+            }
+            // Always update current oldest page time referenced or not
+            tmin = vm->ft.load_time[f];
+        }
+    }
+
+    if(k == -1){
+        if(j == -1){
+            return -1;
+        }
+        k = j;
+    }
+    
+    return k;
+}
+
+static inline long long lru_scan(VirtualMemory *vm, const long long* list, long long n, int direct){
+    long long f, k = -1;
+    unsigned int tmin = 0;
+
+    for(long long i = 0; i < n; i++) {
+        f = direct ? i : list[i];
+        if(!(vm->ft.flags[f] & FR_USED) || FR_PINNED(vm->ft.flags[f]))
+            continue;
+        if(k == -1 || time_before(vm->ft.reference_time[f], tmin)){
+            tmin = vm->ft.reference_time[f];
+            k = f;
+        }
+    }
+    
+    return k;
+}
+
+/*
+    Global and local victim selection for a scan. Local allocation only
+    looks at the frames of owner and falls back to every frame.
+*/
+#define DEFINE_VICTIM(name, scan)                                           \
+long long name##_global(VirtualMemory *vm, int owner){                      \
+    return scan(vm, NULL, vm->n_pframes, 1);                                        \
+}                                                                           \
+long long name##_local(VirtualMemory *vm, int owner){                       \
+    long long j = -1;                                                       \
+    if(owner > 0)                                                           \
+        j = scan(vm, vm->owner_frames[owner], vm->n_owner_frames[owner], 0);            \
+    if(j == -1){                                                            \
+        debug("Local allocation failed, trying global allocation\n");       \
+        j = scan(vm, NULL, vm->n_pframes, 1);                                       \
+    }                                                                       \
+    return j;                                                               \
+}
+
+DEFINE_VICTIM(NRU, nru_scan)
+DEFINE_VICTIM(FIFO, fifo_scan)
+DEFINE_VICTIM(SC, sc_scan)
+DEFINE_VICTIM(LRU, lru_scan)
+
+/*
+    Policy table, [PR type][AP type] in PR_TYPES and AP_TYPES order.
+    Every built-in policy keeps its state in the frame table flags and
+    timestamps updated by frame_touch, so the hooks are left empty.
+    tick is called without mutex_access held.
+*/
+const Policy POLICIES[][2] = {
+    {{"NRU",  NULL, NULL, NULL, NRU_global,  NULL, reset_r_bit},
+     {"NRU",  NULL, NULL, NULL, NRU_local,   NULL, reset_r_bit}},
+    {{"FIFO", NULL, NULL, NULL, FIFO_global, NULL, NULL},
+     {"FIFO", NULL, NULL, NULL, FIFO_local,  NULL, NULL}},
+    {{"SC",   NULL, NULL, NULL, SC_global,   NULL, NULL},
+     {"SC",   NULL, NULL, NULL, SC_local,    NULL, NULL}},
+    {{"LRU",  NULL, NULL, NULL, LRU_global,  NULL, NULL},
+     {"LRU",  NULL, NULL, NULL, LRU_local,   NULL, NULL}},
+};
+
+// Picks the policy for page_replacement and alloc_policy, called once per test group
+void policy_resolve(VirtualMemory *vm){
+    if(vm->pr < 0 || vm->pr >= PR_N || vm->ap < 0 || vm->ap >= AP_N) _errExit("Invalid algorithm @policy_resolve");
+    vm->policy = &POLICIES[vm->pr][vm->ap];
+}
+
+/*
+    Clock interrupt of vm(arg), runs the policy tick until
+    exit_requested is set
+*/
+void *thread_clock_interrupt(void *arg){
+    VirtualMemory *vm = arg;
+
+    while(!vm->exit_requested) {
+        int ticking = 0;
+
+        // Runs without mutex_access, shadows get the same interrupts
+        for(int i = -1; i < vm->n_shadows; i++){
+            VirtualMemory *m = (i == -1) ? vm : vm->shadows[i];
+            if(m->policy->tick != NULL){
+                m->policy->tick(m);
+                ticking = 1;
+            }
+        }
+        if(!ticking)
+            break;
+        nanosleep((const struct timespec[]){{0, 400000000L}}, NULL); //40ms
+    }
+    
+    pthread_exit(0);
+}
+
+// Clears every R bit at once, frames referenced before now hold an older epoch
+void reset_r_bit(VirtualMemory *vm) {
+    __atomic_fetch_add(&vm->r_epoch, 1, __ATOMIC_RELAXED);
+}
+
+void apply_aging(VirtualMemory *vm){
+    for(long long i = 0; i < vm->n_pframes; i++){
+        if(vm->ft.flags[i] & FR_USED)
+            vm->ft.age[i]++;
+    }
+    reset_r_bit(vm);
+}
+
+// Returns a frame to evict, -1 if every candidate is pinned
+long long find_victim(VirtualMemory *vm, int owner){
+    return vm->policy->select_victim(vm, owner);
+}
+
+/*
+    Returns the lowest free frame if one is available, -1 otherwise.
+    Frames are never freed while vm lives, so words skipped once never
+    need to be looked at again and the search is O(1) amortized.
+*/
+long long find_free_addr(VirtualMemory *vm){
+    while(vm->free_hint < vm->bitmap_words && vm->bitmap[vm->free_hint] == 0)
+        vm->free_hint++;
+    if(vm->free_hint == vm->bitmap_words)
+        return -1;
+    return vm->free_hint * 64 + __builtin_ctzll(vm->bitmap[vm->free_hint]);
+}
+
+int pr_validity(const char* type){
+    for(int i = 0; i < PR_N; i++){
+        if(strncmp(type, PR_TYPES[i], strlen(PR_TYPES[i])) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int ap_validity(const char* type){
+    for(int i = 0; i < AP_N; i++){
+        if(strncmp(type, AP_TYPES[i], strlen(AP_TYPES[i])) == 0)
+            return i;
+    }
+    return -1;
+}
+
+void print_entry(VirtualMemory *vm, long long vpn){
+    Entry e = *pt_walk(vm, vpn);
+    long long j = PTE_FRAME(e);
+    int present = (e & PTE_PRESENT) != 0;
+    debug("%-12s%-12s%-12s%-12s%-12s%-7s\n", "Virtual", "Physical", "Present", "Modified", "Referenced", "Owner");
+    debug("%-12llu%-12lld%-12d%-12d%-12d%-7d\n",
+                                    (unsigned long long) vpn * vm->f_size,
+                                    present ? j * vm->f_size : -1,
+                                    present,
+                                    present ? (vm->ft.flags[j] & FR_MODIFIED) != 0 : 0,
+                                    present ? FR_REFERENCED(vm, j) : 0,
+                                    present ? vm->ft.owner[j] : 0);
+    debug("=================================\n");
+}
+
+void print_pt(VirtualMemory *vm){
+    printf("=========================================================\n");
+    printf("%-12s%-12s%-12s%-12s%-12s%-7s\n", "Virtual", "Physical", "Present", "Modified", "Referenced", "Owner");
+    for(long long i = 0; i < pt_n_touched(vm); i++){
+        Entry e = *pt_touched(vm, i);
+        long long j = PTE_FRAME(e);
+        int present = (e & PTE_PRESENT) != 0;
+        printf("%-12llu%-12lld%-12d%-12d%-12d%-7d\n",
+                                    (unsigned long long) pt_touched_vpn(vm, i) * vm->f_size,
+                                    present ? j * vm->f_size : -1,
+                                    present,
+                                    present ? (vm->ft.flags[j] & FR_MODIFIED) != 0 : 0,
+                                    present ? FR_REFERENCED(vm, j) : 0,
+                                    present ? vm->ft.owner[j] : 0);
+    }
+    printf("=========================================================\n");
+}
@@ -0,0 +1,377 @@
+//
+//  vm.h
+//  Virtual Memory Part 3
+//
+//  Created by Muhammed Okumuş on 23.06.2020.
+//  Copyright 2020 Muhammed Okumus. All rights reserved.
+//
+
+#ifndef VM_H
+#define VM_H
+
+#define _FILE_OFFSET_BITS 64     // 64-bit off_t for fseeko on large disk files
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stdint.h>
+
+#include "mrc.h"
+#include "trace.h"
+
+#define NAME 32
+#define DEBUG 0
+#define MAX_PATH 1024
+#define PT_BITS 9           // Page number bits per lower page table level
+#define PT_MAX_LEVELS 4
+#define CACHE_LINE 64
+#define TLB_SIZE 64         // Translation cache entries, power of 2
+#define SP_ORDER 3          // Superpage is 2^SP_ORDER base pages
+#define SP_PAGES (1 << SP_ORDER)
+#define STLB_SIZE 16        // Superpage translation cache entries, power of 2
+#define HUGE_PAGE (2UL << 20)   // Host huge page size for the physical memory arena
+#define CLOCK_CLAMP (1u << 30)  // Frame timestamps are kept within 2*CLOCK_CLAMP ticks of access_clock
+
+/*==============================
+=            Macros            =
+==============================*/
+
+#define _errExit(msg) do{ perror(msg); exit(EXIT_FAILURE); } while(0)
+#define debug(f_, ...) if(DEBUG == 1) printf((f_), ##__VA_ARGS__)
+
+/*============================================
+=            Page Table Structure            =
+============================================*/
+
+/*
+    Page table entry packed in one word, present bit and frame number.
+    The virtual address is implied by the position in the table.
+*/
+typedef unsigned int Entry;
+
+#define PTE_PRESENT 0x80000000u
+#define PTE_SUPER   0x40000000u         // Page is part of a promoted superpage
+#define PTE_FRAME(e) ((long long) ((e) & ~(PTE_PRESENT | PTE_SUPER)))
+
+/*
+    Inverted page table, one slot per physical frame, stored as separate
+    arrays. Replacement scans only read the hot arrays, flags and the
+    32-bit timestamps, bookkeeping lives in the cold ones.
+*/
+typedef struct{
+    // Hot
+    unsigned int* flags;                // FR_* bits and pin count
+    unsigned int* ref_epoch;            // R bit, set while equal to r_epoch
+    unsigned int* reference_time;       // Last reference, low 32 bits of access_clock
+    unsigned int* load_time;            // Page in time, low 32 bits of access_clock
+    // Cold
+    long long* vpn;                     // Virtual page in the frame, -1 if free
+    int* owner;                         // Owner process ID, -1 if free
+    long long* owner_pos;               // Position in owner_frames[owner]
+    unsigned int* generation;           // Incremented every time the frame gets a new page
+    int* age;                           // Age counter
+}FrameTable;
+
+#define FR_USED         0x1u            // Frame holds a page
+#define FR_MODIFIED     0x4u            // Modified bit
+#define FR_PIN_SHIFT    8               // Pin count is kept above the flag bits
+#define FR_PIN_ONE      (1u << FR_PIN_SHIFT)
+
+// R bit of frame f, clearing every R bit is advancing r_epoch
+#define FR_REFERENCED(vm, f) ((vm)->ft.ref_epoch[f] == __atomic_load_n(&(vm)->r_epoch, __ATOMIC_RELAXED))
+#define FR_SET_R(vm, f)      ((vm)->ft.ref_epoch[f] = __atomic_load_n(&(vm)->r_epoch, __ATOMIC_RELAXED))
+#define FR_CLEAR_R(vm, f)    ((vm)->ft.ref_epoch[f] = __atomic_load_n(&(vm)->r_epoch, __ATOMIC_RELAXED) - 1)
+#define FR_PINNED(fl)   ((fl) >> FR_PIN_SHIFT)
+
+typedef struct{
+    int page_size;
+    int levels;                         // # of radix levels, 2 to PT_MAX_LEVELS
+    int bits[PT_MAX_LEVELS];            // Page number bits resolved by each level, [0] is the root
+    int shift[PT_MAX_LEVELS];           // Page number shift of each level
+    void** root;                        // Root directory, lower levels allocated on first touch
+    Entry** leaves;                     // Allocated leaves in allocation order
+    long long* leaf_base;               // First page number of each leaf
+    long long n_leaves;
+    long long cap_leaves;
+    unsigned long long pt_bytes;        // Memory held by the page table
+}PageTable;
+
+// Translation cache entry, page number to page table entry
+typedef struct{
+    long long vpn;
+    Entry* e;
+}TLBEntry;
+
+/*==========================================
+=            Statistics Structs            =
+==========================================*/
+
+/*
+    Counters of one context, padded to its own cache lines so threads
+    charging different contexts never share a line. Read them through
+    ctx_snapshot/stats_total to get a consistent copy while running,
+    without taking mutex_access.
+*/
+typedef struct{
+    char name[NAME];
+    int owner;
+    unsigned long long n_reads;
+    unsigned long long n_writes;
+    unsigned long long n_misses;
+    unsigned long long n_replacements;
+    unsigned long long n_dpw;
+    unsigned long long n_dpr;
+    unsigned long long n_pins;
+} __attribute__((aligned(CACHE_LINE))) Stats;
+
+typedef struct VirtualMemory VirtualMemory;
+
+/*
+    Access context of one simulated process, passed to every access
+    function. Holds the owner ID used for local allocation, the stats
+    accesses are charged to and private translation caches.
+*/
+typedef struct{
+    VirtualMemory* vm;          // Memory the context accesses
+    int index;                  // Position in vm->contexts, the same in shadows
+    int id;                     // Owner ID, 0 for shared contexts
+    int owner;                  // Owner ID in effect, 0 under global allocation
+    int shared;                 // Never owns frames(checker)
+    Stats stats;
+    unsigned int stats_seq;     // Sequence lock of stats, odd while they are updated
+    TLBEntry tlb[TLB_SIZE];     // Base page translations
+    TLBEntry stlb[STLB_SIZE];   // Superpage translations, tagged by vpn >> SP_ORDER
+    struct Cursor* cursors;     // Open cursors, they give up their pins before the context waits
+    long long run_frame;        // Frame the uncharged cursor accesses are on, -1 if none
+    int run_write;              // First access of the run was a write
+} Context;
+
+/*
+    Page replacement policy. Hooks may be NULL. select_victim returns an
+    unpinned frame holding a page or -1, it is resolved per allocation
+    policy. on_hit is only called when set so built-in policies keep the
+    hit path free of indirect calls.
+*/
+typedef struct{
+    const char* name;
+    void (*init)(VirtualMemory *vm);        // Frame table was rebuilt
+    void (*on_hit)(VirtualMemory *vm, long long f, int write);
+    void (*on_fault)(VirtualMemory *vm, long long f, int write);    // Frame f got a new page
+    long long (*select_victim)(VirtualMemory *vm, int owner);
+    void (*on_evict)(VirtualMemory *vm, long long f);     // Page in frame f is about to leave
+    void (*tick)(VirtualMemory *vm);        // Clock interrupt, NULL if not needed
+} Policy;
+
+/*
+    One simulated machine, disk file, physical memory, page tables and
+    replacement state. Instances share nothing, several can run at once.
+*/
+struct VirtualMemory{
+    // Geometry
+    unsigned long long n_words;  // # of integers in memory
+    long long n_vframes;    // # of virtual frames
+    long long n_pframes;    // # of physical frames
+    long long n_entries;    // # of page table entries(virtual pages)
+    int f_size;             // frame size f_size = (2^N)
+    long long m_size;       // physical memory size
+    int num_virtual;        // log2 of n_vframes
+
+    int pr, ap;             // Index in PR_TYPES and AP_TYPES
+    const Policy* policy;   // Page replacement in effect
+
+    PageTable pt;           // Radix page table
+    FrameTable ft;          // Inverted page table, indexed by physical frame
+    long long* all_frames;  // Every frame number, candidates for global allocation
+    long long** owner_frames;   // Frames of each owner, candidates for local allocation
+    long long* n_owner_frames;
+    int n_owners;           // Owner IDs handed out, 0 is shared
+    Context** contexts;     // Every access context
+    int n_contexts;
+
+    int* memory;            // Physical memory
+    void* arena;            // Mapping that holds memory
+    size_t arena_len;
+    const char* arena_backing;  // Host pages behind the arena
+    unsigned long long* bitmap;  // One bit per physical frame, set while the frame is free
+    long long bitmap_words;  // # of 64-bit words in use for n_pframes
+    long long free_hint;    // Words before this one have no free frames
+    long long sp_block_hint;    // Aligned frame blocks before this one are not fully free
+    FILE * fd;              // VM file
+    char disk_file[MAX_PATH];
+
+    unsigned long long tlb_hits, tlb_misses;
+    long long sp_promotions, sp_demotions, sp_active;
+    unsigned int r_epoch;   // R bit epoch, see FR_REFERENCED
+    unsigned long long access_clock;    // Logical time, ticks once per page reference
+    Mrc* mrc;               // Reuse distance recorder of the page stream, NULL if off
+    Shards* shards;         // Sampled recorder of the page stream, NULL if off
+    Trace* trace;           // Recorder of the accesses, NULL if off
+    VirtualMemory** shadows;    // Metadata only machines fed the same page stream
+    int n_shadows;
+    VirtualMemory* primary; // Machine a shadow follows, NULL if not a shadow
+
+    pthread_mutex_t mutex_access;
+    pthread_cond_t cond_unpin;  // Signaled when a frame gets unpinned
+    int n_pinned;           // # of frames currently pinned
+    int max_pinned;         // Peak of n_pinned
+    int exit_requested;
+};
+
+/*
+    View into physical memory for a single pinned page, data[0] is the
+    integer at index start. Callers add the integers they touch to n_reads
+    and n_writes, they are charged to the thread stats on unpin.
+*/
+typedef struct{
+    int* data;
+    unsigned long long start;
+    unsigned long long len;
+    long long frame;
+    unsigned long long n_reads;
+    unsigned long long n_writes;
+} Span;
+
+#define PIN_READ 0
+#define PIN_WRITE 1
+
+/*
+    Sequential access handle. The page under index is pinned while the
+    cursor is on it, reads and writes there go straight to the frame and
+    are only counted in the cursor. A context keeps one such run open, an
+    access to any other page charges it first as that many references in
+    a row, so the clock, R/M bits, recorders and shadows see the same
+    stream as get/set. Accesses of other threads made during a run are
+    ordered before it, and the pinned page can not be a victim while the
+    cursor is on it.
+*/
+typedef struct Cursor{
+    Context* c;
+    unsigned long long index;   // Current position
+    unsigned long long lo, hi;  // Index range of the pinned page
+    long long frame;            // Pinned frame, -1 if none
+    int* base;                  // Start of the pinned frame in memory
+    unsigned int generation;    // Generation of the frame when pinned
+    unsigned long long n_reads; // Accesses not charged yet
+    unsigned long long n_writes;
+    struct Cursor* next;        // Next open cursor of c
+} Cursor;
+
+/*========================================
+=            Global Constants            =
+========================================*/
+
+extern const char* PR_TYPES[];
+extern const char* AP_TYPES[];
+extern const int PR_N;
+extern const int AP_N;
+
+/*===========================================
+=            Function Prototypes            =
+===========================================*/
+
+// Misc Functions
+unsigned int vm_tick(VirtualMemory *vm);
+unsigned int vm_advance(VirtualMemory *vm, unsigned long long n);
+void clamp_times(VirtualMemory *vm);
+int time_before(unsigned int t1, unsigned int t2);
+void print_stats(FILE *out, const Stats *s);
+
+// Debug Functions
+void print_entry(VirtualMemory *vm, long long vpn);
+
+// Error Checking Functions
+int pr_validity(const char* type);
+int ap_validity(const char* type);
+
+// VM Functions
+VirtualMemory* vm_create(const char* disk_file, int frame_size, int num_virtual, int num_physical,
+                         int pr, int ap, unsigned int seed);
+void vm_destroy(VirtualMemory *vm);
+VirtualMemory* vm_add_shadow(VirtualMemory *vm, int pr, int ap);
+void print_shadow_stats(VirtualMemory *vm, FILE *out);
+void vm_trace_start(VirtualMemory *vm, const char* path);
+unsigned long long vm_trace_stop(VirtualMemory *vm);
+unsigned long long vm_replay(VirtualMemory *vm, TraceReader *r, int interleaved);
+void initilize_vm(VirtualMemory *vm, unsigned int seed);
+void print_pt(VirtualMemory *vm);
+void print_vm_stats(VirtualMemory *vm, FILE *out);
+long long to_addr_space(VirtualMemory *vm, unsigned long long i);
+long long find_free_addr(VirtualMemory *vm);
+long long find_victim(VirtualMemory *vm, int owner);
+
+// Access Context Functions
+Context* ctx_create(VirtualMemory *vm, const char* name, int shared);
+Context* ctx_fork(Context *parent, const char* name);
+void ctx_reset(Context *c);
+Stats ctx_snapshot(Context *c);
+long long ctx_frames(Context *c);
+Stats stats_total(VirtualMemory *vm);
+void stats_add(Stats *t, const Stats *s);
+void ctx_free_all(VirtualMemory *vm);
+
+// Physical Memory Arena Functions
+int* arena_alloc(VirtualMemory *vm, size_t bytes);
+void arena_free(VirtualMemory *vm);
+
+// Inverted Page Table Functions
+void frames_init(VirtualMemory *vm);
+void frames_free(VirtualMemory *vm);
+void frame_set_owner(VirtualMemory *vm, long long f, int owner);
+
+// Page Table Functions
+void pt_init(VirtualMemory *vm);
+void pt_free(VirtualMemory *vm);
+void pt_free_node(VirtualMemory *vm, void** node, int level);
+Entry* pt_alloc_leaf(VirtualMemory *vm, long long base_vpn);
+Entry* pt_walk(VirtualMemory *vm, long long vpn);
+Entry* pt_entry(long long vpn, Context *c);
+long long pt_n_touched(VirtualMemory *vm);
+Entry* pt_touched(VirtualMemory *vm, long long i);
+long long pt_touched_vpn(VirtualMemory *vm, long long i);
+
+// Superpage Functions
+int sp_enabled(VirtualMemory *vm);
+void sp_try_promote(VirtualMemory *vm, long long vpn);
+void sp_demote(VirtualMemory *vm, long long vpn);
+void sp_write_back(VirtualMemory *vm, long long vpn);
+long long sp_place(VirtualMemory *vm, long long vpn);
+void tlb_shootdown(VirtualMemory *vm, long long vpn);
+unsigned long long tlb_reach(Context *c);
+
+// Get/Set Functions
+void set(unsigned long long index, int value, Context *c);
+int get(unsigned long long index, Context *c);
+long long page_in(unsigned long long index, Context *c, int write);
+void get_range(unsigned long long start, unsigned long long len, int* buf, Context *c);
+void set_range(unsigned long long start, unsigned long long len, const int* buf, Context *c);
+void copy_range(unsigned long long dst, unsigned long long src, unsigned long long len, Context *c);
+Span pin(unsigned long long index, int mode, Context *c);
+void unpin(Span *sp, Context *c);
+
+// Cursor Functions
+void cursor_open(Cursor *cur, unsigned long long index, Context *c);
+void cursor_close(Cursor *cur);
+void cursor_seek(Cursor *cur, unsigned long long index);
+void cursor_next(Cursor *cur);
+void cursor_prev(Cursor *cur);
+long long cursor_page(Cursor *cur, int write);
+int cursor_read(Cursor *cur);
+void cursor_write(Cursor *cur, int value);
+
+// Page Replacement Functions
+void policy_resolve(VirtualMemory *vm);
+void frame_touch(VirtualMemory *vm, long long j, int write);
+
+// Clock Interrupt Routines
+void reset_r_bit(VirtualMemory *vm);
+void apply_aging(VirtualMemory *vm);
+void *thread_clock_interrupt(void *arg);
+
+#endif
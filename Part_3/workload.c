@@ -0,0 +1,212 @@
+//
+//  workload.c
+//  Virtual Memory Part 3
+//
+//  Created by Muhammed Okumuş on 23.06.2020.
+//  Copyright 2020 Muhammed Okumus. All rights reserved.
+//
+
+#include "workload.h"
+
+const char* GEN_TYPES[] = {"uniform", "zipf", "seq", "loop", "hotcold", "phase"};
+
+/*=============================================
+=            Random Numbers                   =
+=============================================*/
+
+// xorshift64*, state must not be 0
+static inline uint64_t gen_rand(Generator *g){
+    g->rng ^= g->rng >> 12;
+    g->rng ^= g->rng << 25;
+    g->rng ^= g->rng >> 27;
+    return g->rng * 0x2545f4914f6cdd1dULL;
+}
+
+// Uniform in [0, 1)
+static inline double gen_rand01(Generator *g){
+    return (gen_rand(g) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Uniform in [0, n)
+static inline unsigned long long gen_below(Generator *g, unsigned long long n){
+    return (unsigned long long) (gen_rand01(g) * n);
+}
+
+/*=============================================
+=            Spec Parsing                     =
+=============================================*/
+
+/**
+ *  Parses pattern[:key=value,...] into spec, e.g. zipf:theta=0.9,ops=100000
+ *  Returns -1 if the pattern, a key or a value is not valid.
+ */
+int gen_parse(const char* s, GenSpec *spec){
+    char buf[256], *key, *save = NULL;
+    int hi_given = 0;
+    const char* colon = strchr(s, ':');
+    size_t n = colon ? (size_t) (colon - s) : strlen(s);
+
+    memset(spec, 0, sizeof(GenSpec));
+    spec->pattern = -1;
+    for(int i = 0; i < G_PATTERNS; i++){
+        if(strlen(GEN_TYPES[i]) == n && strncmp(s, GEN_TYPES[i], n) == 0)
+            spec->pattern = i;
+    }
+    if(spec->pattern == -1)
+        return -1;
+    if(colon == NULL)
+        return 0;
+
+    snprintf(buf, sizeof(buf), "%s", colon + 1);
+    for(key = strtok_r(buf, ",", &save); key != NULL; key = strtok_r(NULL, ",", &save)){
+        char *val = strchr(key, '='), *end;
+        double v;
+
+        if(val == NULL)
+            return -1;
+        *val++ = '\0';
+        v = strtod(val, &end);
+        if(*end != '\0' || v < 0)
+            return -1;
+
+        if     (strcmp(key, "ops") == 0)   { spec->n_ops = (unsigned long long) v;     spec->set |= GS_OPS; }
+        else if(strcmp(key, "write") == 0) { spec->write_ratio = v;                    spec->set |= GS_WRITE; }
+        else if(strcmp(key, "theta") == 0) { spec->theta = v;                          spec->set |= GS_THETA; }
+        else if(strcmp(key, "hot") == 0)   { spec->hot_frac = v;                       spec->set |= GS_HOT; }
+        else if(strcmp(key, "prob") == 0)  { spec->hot_prob = v;                       spec->set |= GS_PROB; }
+        else if(strcmp(key, "phase") == 0) { spec->phase_len = (unsigned long long) v; spec->set |= GS_PHASE; }
+        else if(strcmp(key, "loop") == 0)  { spec->loop_len = (unsigned long long) v;  spec->set |= GS_LOOP; }
+        else if(strcmp(key, "lo") == 0)    { spec->lo = v;                             spec->set |= GS_RANGE; }
+        else if(strcmp(key, "hi") == 0)    { spec->hi = v; hi_given = 1;               spec->set |= GS_RANGE; }
+        else if(strcmp(key, "seed") == 0)  spec->seed = (unsigned int) v;
+        else return -1;
+    }
+
+    // A range given by one end only runs to the other end of the VM
+    if((spec->set & GS_RANGE) && !hi_given)
+        spec->hi = 1;
+
+    // Phase and loop lengths divide positions, they can not be 0
+    if(spec->write_ratio > 1 || spec->hot_frac > 1 || spec->hot_prob > 1 || spec->theta >= 1 ||
+       spec->lo > 1 || spec->hi > 1 || ((spec->set & GS_RANGE) && spec->hi <= spec->lo) ||
+       ((spec->set & GS_PHASE) && spec->phase_len == 0) || ((spec->set & GS_LOOP) && spec->loop_len == 0))
+        return -1;
+    return 0;
+}
+
+// Short description of the spec after defaults, for reports
+void gen_describe(const GenSpec *s, char* buf, size_t n){
+    switch(s->pattern){
+        case G_ZIPF:    snprintf(buf, n, "zipf theta=%.2f", s->theta); break;
+        case G_LOOP:    snprintf(buf, n, "loop %llu words", s->loop_len); break;
+        case G_HOTCOLD: snprintf(buf, n, "hotcold %.2f/%.2f", s->hot_frac, s->hot_prob); break;
+        case G_PHASE:   snprintf(buf, n, "phase %.2f/%.2f every %llu", s->hot_frac, s->hot_prob, s->phase_len); break;
+        default:        snprintf(buf, n, "%s", GEN_TYPES[s->pattern]); break;
+    }
+}
+
+/*=============================================
+=            Generators                       =
+=============================================*/
+
+/**
+ *  Sets up g to access words [start, start + len) following spec.
+ *  ram_words(the physical memory size) sets the default loop length,
+ *  1.5 x RAM so a loop never fits.
+ */
+void gen_init(Generator *g, const GenSpec *spec, unsigned long long start, unsigned long long len,
+              unsigned long long ram_words){
+    GenSpec *s = &g->spec;
+
+    memset(g, 0, sizeof(Generator));
+    *s = *spec;
+    g->start = start;
+    g->len = len > 0 ? len : 1;
+    g->rng = 0x9e3779b97f4a7c15ULL ^ ((uint64_t) s->seed << 32 | s->pattern);
+    if(g->rng == 0) g->rng = 1;
+
+    if(!(s->set & GS_WRITE)) s->write_ratio = 0.25;
+    if(!(s->set & GS_THETA)) s->theta = 0.99;
+    if(!(s->set & GS_HOT))   s->hot_frac = 0.1;
+    if(!(s->set & GS_PROB))  s->hot_prob = 0.9;
+    if(!(s->set & GS_LOOP))  s->loop_len = ram_words + ram_words / 2;
+    if(s->loop_len > g->len) s->loop_len = g->len;
+    if(!(s->set & GS_OPS))
+        s->n_ops = (s->pattern == G_LOOP) ? 4 * s->loop_len : g->len;
+    if(!(s->set & GS_PHASE)) s->phase_len = s->n_ops / 4 + 1;
+
+    g->hot_len = (unsigned long long) (s->hot_frac * g->len);
+    if(g->hot_len == 0) g->hot_len = 1;
+
+    if(s->pattern == G_ZIPF){
+        // Gray et al., Quickly Generating Billion-Record Synthetic Databases
+        for(unsigned long long i = 1; i <= g->len; i++)
+            g->zeta_n += 1.0 / pow(i, s->theta);
+        g->zeta_2 = 1.0 + 1.0 / pow(2, s->theta);
+        g->alpha = 1.0 / (1.0 - s->theta);
+        g->eta = (1.0 - pow(2.0 / g->len, 1.0 - s->theta)) / (1.0 - g->zeta_2 / g->zeta_n);
+    }
+}
+
+/**
+ *  Next access of g, index gets the word. Returns 1 for a write, 0 for
+ *  a read and -1 once spec.n_ops accesses were made.
+ */
+int gen_next(Generator *g, unsigned long long *index){
+    GenSpec *s = &g->spec;
+    unsigned long long off;
+
+    if(g->n_done == s->n_ops)
+        return -1;
+
+    switch(s->pattern){
+        case G_ZIPF: {
+            double u = gen_rand01(g), uz = u * g->zeta_n;
+            unsigned long long rank;
+
+            if(uz < 1.0)                             rank = 0;
+            else if(uz < g->zeta_2)                  rank = 1;
+            else rank = (unsigned long long) (g->len * pow(g->eta * u - g->eta + 1.0, g->alpha));
+            if(rank >= g->len) rank = g->len - 1;
+            // Scatter ranks so popular words do not share pages
+            off = ((rank + 1) * 0x9e3779b97f4a7c15ULL) % g->len;
+            break;
+        }
+        case G_SEQ:
+            off = g->pos;
+            g->pos = (g->pos + 1) % g->len;
+            break;
+        case G_LOOP:
+            off = g->pos;
+            g->pos = (g->pos + 1) % s->loop_len;
+            break;
+        case G_PHASE:
+            if(g->n_done % s->phase_len == 0)
+                g->hot_base = gen_below(g, g->len);
+            // Fall through
+        case G_HOTCOLD:
+            if(gen_rand01(g) < s->hot_prob)
+                off = (g->hot_base + gen_below(g, g->hot_len)) % g->len;
+            else
+                off = (g->hot_base + g->hot_len + gen_below(g, g->len - g->hot_len)) % g->len;
+            break;
+        default:
+            off = gen_below(g, g->len);
+            break;
+    }
+
+    g->n_done++;
+    *index = g->start + off;
+    return gen_rand01(g) < s->write_ratio;
+}
+
+// Issues every access of g as c
+void gen_run(Generator *g, Context *c){
+    unsigned long long index;
+    int w;
+
+    while((w = gen_next(g, &index)) != -1){
+        if(w) set(index, (int) g->rng, c);
+        else  get(index, c);
+    }
+}
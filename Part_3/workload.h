@@ -0,0 +1,80 @@
+//
+//  workload.h
+//  Virtual Memory Part 3
+//
+//  Created by Muhammed Okumuş on 23.06.2020.
+//  Copyright 2020 Muhammed Okumus. All rights reserved.
+//
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include "vm.h"
+
+/*===========================================
+=            Synthetic Workloads            =
+===========================================*/
+
+enum{
+    G_UNIFORM,          // Every word of the range equally likely
+    G_ZIPF,             // Zipfian popularity with skew theta, ranks scattered over the range
+    G_SEQ,              // One pass over the range
+    G_LOOP,             // Repeated passes over loop words, larger than RAM by default
+    G_HOTCOLD,          // hot of the range gets prob of the accesses
+    G_PHASE,            // Hot/cold with the hot set moving every phase accesses
+    G_PATTERNS
+};
+
+// Keys given in a spec, GenSpec.set
+#define GS_OPS   (1 << 0)
+#define GS_WRITE (1 << 1)
+#define GS_THETA (1 << 2)
+#define GS_HOT   (1 << 3)
+#define GS_PROB  (1 << 4)
+#define GS_PHASE (1 << 5)
+#define GS_LOOP  (1 << 6)
+#define GS_RANGE (1 << 7)   // lo or hi
+
+/*
+    Configuration of one generator thread, parsed from
+    pattern[:key=value,...] by gen_parse. Keys missing from set take the
+    pattern defaults in gen_init, so zero is a value like any other.
+*/
+typedef struct{
+    int pattern;
+    int set;                        // GS_* of the keys given
+    unsigned long long n_ops;       // ops: accesses to issue
+    double write_ratio;             // write: share of accesses that are set
+    double theta;                   // theta: zipf skew in (0, 1)
+    double hot_frac, hot_prob;      // hot, prob
+    unsigned long long phase_len;   // phase: accesses per phase
+    unsigned long long loop_len;    // loop: words per pass
+    double lo, hi;                  // lo, hi: range as fractions of the virtual memory
+    unsigned int seed;              // seed
+} GenSpec;
+
+// Generator state, one per thread
+typedef struct{
+    GenSpec spec;
+    unsigned long long start, len;  // Range in words
+    unsigned long long pos;         // Scan position
+    unsigned long long hot_base, hot_len;
+    unsigned long long n_done;
+    uint64_t rng;
+    double zeta_n, zeta_2, alpha, eta;  // Zipf constants
+} Generator;
+
+/*===========================================
+=            Function Prototypes            =
+===========================================*/
+
+extern const char* GEN_TYPES[];
+
+int gen_parse(const char* s, GenSpec *spec);
+void gen_describe(const GenSpec *spec, char* buf, size_t n);
+void gen_init(Generator *g, const GenSpec *spec, unsigned long long start, unsigned long long len,
+              unsigned long long ram_words);
+int gen_next(Generator *g, unsigned long long *index);
+void gen_run(Generator *g, Context *c);
+
+#endif